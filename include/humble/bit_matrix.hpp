@@ -0,0 +1,234 @@
+#ifndef LIBHUMBLE_CPP_BIT_MATRIX_HPP_
+#define LIBHUMBLE_CPP_BIT_MATRIX_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "posix/aligned_allocator.h"
+#include "bitset.hpp"
+
+namespace hmbl
+{
+
+namespace detail
+{
+
+/// Transpose 64x64 bit block in place: bit c of word r is swapped with bit r of word c.
+/// Recursive block swap (Hacker's Delight 7-3), every step is vectorized over word pairs
+inline void transpose_64x64(uint64_t blk[64]) noexcept
+{
+    uint64_t m = 0x00000000FFFFFFFF;
+    for (size_t j = 32; j; j >>= 1, m ^= m << j)
+    {
+        // swap high j bits of words [base, base + j) with low j bits of words [base + j, base + 2j)
+        for (size_t base = 0; base < 64; base += 2 * j)
+        {
+            size_t k = base;
+#if defined(__AVX2__)
+            {
+                const __m256i vm    = _mm256_set1_epi64x(m);
+                const __m128i shift = _mm_cvtsi64_si128(j);
+                for (; k + 4 <= base + j; k += 4)
+                {
+                    auto  *lo_p = reinterpret_cast<__m256i*>(blk + k);
+                    auto  *hi_p = reinterpret_cast<__m256i*>(blk + k + j);
+                    __m256i lo  = _mm256_load_si256(lo_p);
+                    __m256i hi  = _mm256_load_si256(hi_p);
+                    __m256i t   = _mm256_and_si256(_mm256_xor_si256(_mm256_srl_epi64(lo, shift), hi), vm);
+                    _mm256_store_si256(lo_p, _mm256_xor_si256(lo, _mm256_sll_epi64(t, shift)));
+                    _mm256_store_si256(hi_p, _mm256_xor_si256(hi, t));
+                }
+            }
+#endif
+            {
+                const __m128i vm    = _mm_set1_epi64x(m);
+                const __m128i shift = _mm_cvtsi64_si128(j);
+                for (; k + 2 <= base + j; k += 2)
+                {
+                    auto  *lo_p = reinterpret_cast<__m128i*>(blk + k);
+                    auto  *hi_p = reinterpret_cast<__m128i*>(blk + k + j);
+                    __m128i lo  = _mm_load_si128(lo_p);
+                    __m128i hi  = _mm_load_si128(hi_p);
+                    __m128i t   = _mm_and_si128(_mm_xor_si128(_mm_srl_epi64(lo, shift), hi), vm);
+                    _mm_store_si128(lo_p, _mm_xor_si128(lo, _mm_sll_epi64(t, shift)));
+                    _mm_store_si128(hi_p, _mm_xor_si128(hi, t));
+                }
+            }
+            for (; k < base + j; ++k)
+            {
+                uint64_t t = ((blk[k] >> j) ^ blk[k + j]) & m;
+                blk[k]     ^= t << j;
+                blk[k + j] ^= t;
+            }
+        }
+    }
+}
+
+} // namespace detail
+
+/// @brief Dense boolean matrix stored as an array of hmbl::Bitset rows
+/// @tparam kRows Number of rows
+/// @tparam kCols Number of columns (bits in each row)
+/// @tparam TAllocator Aligned allocator, rebound to the row type
+/// @details Row access is contiguous, column access goes through transposition by 64x64 blocks
+template <size_t kRows, size_t kCols, typename TAllocator = posix::AlignedAllocator<uint64_t, 64>>
+    requires posix::CAlignedAllocator<TAllocator> && (kRows > 0) && (kCols > 0)
+class BitMatrix
+{
+public:
+    using Row = Bitset<kCols, uint64_t>;
+
+private:
+    using Word      = typename Row::Word;
+    using RowsAlloc = typename TAllocator::template rebind<Row>::other;
+
+    static constexpr size_t kBlockSize  = sizeof(Word) * K::kBitsPerByte; // side of transposed block
+    static constexpr size_t kRowWords   = Row::size_words();
+    static constexpr size_t kGroupBits  = 8; // rows combined into one four-russians table
+    static constexpr size_t kGroupSize  = size_t(1) << kGroupBits;
+
+    static_assert(kBlockSize == 64);
+    static_assert(!(kBlockSize % kGroupBits)); // group never crosses a word boundary
+
+    std::vector<Row, RowsAlloc> rows_;
+
+public:
+    BitMatrix() : rows_(kRows) {}
+
+    static constexpr auto rows() noexcept { return kRows; }
+    static constexpr auto cols() noexcept { return kCols; }
+
+    const Row & row(size_t r) const noexcept { assert(r < kRows); return rows_[r]; }
+    Row &       row(size_t r)       noexcept { assert(r < kRows); return rows_[r]; }
+
+    const Row & operator[](size_t r) const noexcept { return row(r); }
+    Row &       operator[](size_t r)       noexcept { return row(r); }
+
+    bool test(size_t r, size_t c) const noexcept { return row(r).test(c); }
+
+    auto & set(size_t r, size_t c, bool val = true) noexcept
+    {
+        row(r).set(c, val);
+        return *this;
+    }
+
+    auto & reset() noexcept
+    {
+        for (auto &r : rows_)
+            r.reset();
+        return *this;
+    }
+
+    bool operator==(const BitMatrix &other) const noexcept
+    {
+        return std::equal(std::cbegin(rows_), std::cend(rows_), std::cbegin(other.rows_));
+    }
+
+    /// Extract column @p c as a bitset of kRows bits
+    Bitset<kRows, uint64_t> column(size_t c) const noexcept
+    {
+        assert(c < kCols);
+        Bitset<kRows, uint64_t> res;
+        const size_t wi = c / kBlockSize;
+        const size_t bi = c % kBlockSize;
+        for (size_t br = 0; br < kRows; br += kBlockSize)
+        {
+            const size_t nr = std::min(kBlockSize, kRows - br);
+            Word w{};
+            for (size_t k = 0; k < nr; ++k)
+                w |= ((rows_[br + k].data()[wi] >> bi) & Word(1)) << k;
+            res.data()[br / kBlockSize] = w;
+        }
+        return res;
+    }
+
+    /// Transposed copy, processed by 64x64 blocks
+    BitMatrix<kCols, kRows, TAllocator> transposed() const
+    {
+        BitMatrix<kCols, kRows, TAllocator> res;
+        alignas(64) Word blk[kBlockSize];
+        for (size_t br = 0; br < kRows; br += kBlockSize)
+        {
+            const size_t nr = std::min(kBlockSize, kRows - br);
+            for (size_t wc = 0; wc < kRowWords; ++wc)
+            {
+                size_t k = 0;
+                for (; k < nr; ++k)
+                    blk[k] = rows_[br + k].data()[wc];
+                for (; k < kBlockSize; ++k)
+                    blk[k] = 0;
+
+                detail::transpose_64x64(blk);
+
+                // padding rows are zero, so bits above kRows stay zero in result rows
+                const size_t bc = wc * kBlockSize;
+                const size_t nc = std::min(kBlockSize, kCols - bc);
+                for (k = 0; k < nc; ++k)
+                    res.row(bc + k).data()[br / kBlockSize] = blk[k];
+            }
+        }
+        return res;
+    }
+
+    /// Boolean product (*this) x @p other using the method of four russians:
+    /// ORs of every subset of kGroupBits consecutive rows of @p other are tabulated once
+    /// and then each row of the result takes one table lookup per group
+    template <size_t kN, typename TOtherAlloc>
+    BitMatrix<kRows, kN, TAllocator> multiply(const BitMatrix<kCols, kN, TOtherAlloc> &other) const
+    {
+        using ResRow      = typename BitMatrix<kRows, kN, TAllocator>::Row;
+        using ResRowAlloc = typename TAllocator::template rebind<ResRow>::other;
+
+        BitMatrix<kRows, kN, TAllocator> res;
+        std::vector<ResRow, ResRowAlloc> table(kGroupSize);
+
+        for (size_t k0 = 0; k0 < kCols; k0 += kGroupBits)
+        {
+            // every subset is a smaller subset plus its lowest row
+            const size_t n = std::min(kGroupBits, kCols - k0);
+            for (size_t m = 1; m < (size_t(1) << n); ++m)
+            {
+                table[m] = table[m & (m - 1)];
+                table[m] |= other.row(k0 + std::countr_zero(m));
+            }
+
+            const size_t wi = k0 / kBlockSize;
+            const size_t bi = k0 % kBlockSize;
+            for (size_t i = 0; i < kRows; ++i)
+            {
+                // bits above kCols are zero, so the index never exceeds filled entries
+                size_t g = (rows_[i].data()[wi] >> bi) & (kGroupSize - 1);
+                if (g)
+                    res.row(i) |= table[g];
+            }
+        }
+        return res;
+    }
+
+    /// In place transitive closure by row ORs (Warshall): row i absorbs row k when i reaches k
+    auto & transitive_closure() noexcept requires (kRows == kCols)
+    {
+        for (size_t k = 0; k < kRows; ++k)
+        {
+            const Row   &rk   = rows_[k]; // OR-ing row k into itself is harmless
+            const Word   mask = Word(1) << (k % kBlockSize);
+            const size_t wi   = k / kBlockSize;
+            for (auto &r : rows_)
+            {
+                if (r.data()[wi] & mask)
+                    r |= rk;
+            }
+        }
+        return *this;
+    }
+};
+
+} // namespace hmbl
+
+#endif // header guard
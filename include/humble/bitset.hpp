@@ -5,7 +5,10 @@
 #include <cstdint>
 #include <bit>
 #include <concepts>
+#include <functional>
 #include <limits>
+#include <optional>
+#include <span>
 #include <type_traits>
 
 #include "detail/memory_traits.h"
@@ -58,6 +61,8 @@ class Bitset
     TWord words_[kNWords]{};
 
 public:
+    using Word = TWord;
+
     constexpr Bitset() = default;
     constexpr Bitset(TWord val) : words_{val}
     {
@@ -68,6 +73,11 @@ public:
     }
 
     static constexpr auto size() noexcept { return kNBits; }
+    static constexpr auto size_words() noexcept { return kNWords; }
+
+    /// Raw words access, bits above size() in the high word MUST stay zero
+    constexpr const TWord *data() const noexcept { return words_; }
+    constexpr TWord       *data() noexcept       { return words_; }
 
     constexpr bool test(size_t pos) const noexcept
     {
@@ -104,26 +114,31 @@ public:
         return Bitset<kSize, TWord, TMemTraits>(*this).flip();
     }
 
+    size_t hash() const noexcept
+    {
+        return MemoryTraits::template const_size_hash<kNWords>(words_);
+    }
+
     constexpr bool operator==(const Bitset<kSize, TWord, TMemTraits> &other) const noexcept
     {
         return MemoryTraits::template const_size_eq<kNWords>(words_, other.words_);
     }
 
-    auto & operator&=(const Bitset<kSize, TWord, TMemTraits> &other) noexcept
+    constexpr auto & operator&=(const Bitset<kSize, TWord, TMemTraits> &other) noexcept
     {
         MemoryTraits::template const_size_bin_op<kNWords>(words_, words_, other.words_,
                                                           [](auto v1, auto v2) { return v1 & v2; });
         return *this;
     }
 
-    auto & operator|=(const Bitset<kSize, TWord, TMemTraits> &other) noexcept
+    constexpr auto & operator|=(const Bitset<kSize, TWord, TMemTraits> &other) noexcept
     {
         MemoryTraits::template const_size_bin_op<kNWords>(words_, words_, other.words_,
                                                           [](auto v1, auto v2) { return v1 | v2; });
         return *this;
     }
 
-    auto & operator^=(const Bitset<kSize, TWord, TMemTraits> &other) noexcept
+    constexpr auto & operator^=(const Bitset<kSize, TWord, TMemTraits> &other) noexcept
     {
         MemoryTraits::template const_size_bin_op<kNWords>(words_, words_, other.words_,
                                                           [](auto v1, auto v2) { return v1 ^ v2; });
@@ -132,65 +147,67 @@ public:
 
     auto & operator>>=(size_t shift) noexcept
     {
-        if (!shift) [[unlikely]] return *this;
-        if (shift > kNBits) [[unlikely]]
-        {
-            reset();
-            return *this;
-        }
-
-        size_t wshift = shift / kBitsPerWord;
-        size_t bshift = shift % kBitsPerWord; // local shift
-        size_t last_w = kNWords - wshift - 1; // last word to be processed
-
-        if (!bshift) [[unlikely]]
-        {
-            for (size_t i = 0; i < last_w; ++i)
-                words_[i] = words_[last_w + wshift];
-        }
-
-        size_t bshift_opposite = kBitsPerWord - bshift;
-        for (size_t i = 0; i < last_w; ++i)
-        {
-            words_[i] = (words_[i + wshift] >> bshift) |
-                        (words_[i + wshift + 1] << bshift_opposite);
-        }
-        words_[last_w] = words_[kNWords - 1] >> bshift;
-        MemoryTraits::template word_set<kWordNoneMask>(words_ + last_w + 1, kNWords - last_w - 1);
+        if (shift >= kNBits) [[unlikely]]
+            return reset();
 
+        MemoryTraits::template const_size_shift_down<kNWords>(words_, shift / kBitsPerWord,
+                                                                      shift % kBitsPerWord);
         // no need to sanitize
         return *this;
     }
 
     auto & operator<<=(size_t shift) noexcept
     {
-        if (!shift) [[unlikely]] return *this;
-        if (shift > kNBits) [[unlikely]]
+        if (shift >= kNBits) [[unlikely]]
+            return reset();
+
+        MemoryTraits::template const_size_shift_up<kNWords>(words_, shift / kBitsPerWord,
+                                                                    shift % kBitsPerWord);
+        hi_word_() &= kHiWordAllMask;
+        return *this;
+    }
+
+    /// Same as operator>>= with the word/bit split resolved at compile time
+    template <size_t kShift>
+    constexpr auto & shift_right() noexcept
+    {
+        if constexpr (kShift >= kNBits)
+            return reset();
+        else
         {
-            reset();
+            MemoryTraits::template const_size_shift_down<kNWords, kShift / kBitsPerWord,
+                                                                  kShift % kBitsPerWord>(words_);
             return *this;
         }
+    }
 
-        size_t wshift = shift / kBitsPerWord;
-        size_t bshift = shift % kBitsPerWord; // local shift
-        size_t last_w = kNWords - wshift - 1; // last word to be processed
-
-        if (!bshift) [[unlikely]]
+    /// Same as operator<<= with the word/bit split resolved at compile time
+    template <size_t kShift>
+    constexpr auto & shift_left() noexcept
+    {
+        if constexpr (kShift >= kNBits)
+            return reset();
+        else
         {
-            for (size_t i = kNWords - 1; i >= wshift; --i)
-                words_[i] = words_[last_w - wshift];
+            MemoryTraits::template const_size_shift_up<kNWords, kShift / kBitsPerWord,
+                                                                kShift % kBitsPerWord>(words_);
+            hi_word_() &= kHiWordAllMask;
+            return *this;
         }
+    }
 
-        size_t bshift_opposite = kBitsPerWord - bshift;
-        for (size_t i = kNWords - 1; i > wshift ; --i)
+    /// Rotate toward higher positions by @p kShift, use rotate<size() - N>() to rotate back
+    template <size_t kShift>
+    constexpr auto & rotate() noexcept
+    {
+        constexpr size_t kRot = kShift % kNBits;
+        if constexpr (kRot)
         {
-            words_[i] = (words_[i - wshift] << bshift) |
-                        (words_[i - wshift - 1] >> bshift_opposite);
+            Bitset wrapped(*this);
+            wrapped.template shift_right<kNBits - kRot>();
+            shift_left<kRot>();
+            *this |= wrapped;
         }
-        words_[wshift] = words_[0] << bshift;
-        MemoryTraits::template word_set<kWordNoneMask>(words_, wshift);
-
-        hi_word_() &= kHiWordAllMask;
         return *this;
     }
 
@@ -211,7 +228,7 @@ public:
         return *this;
     }
 
-    auto & reset() noexcept
+    constexpr auto & reset() noexcept
     {
         MemoryTraits::template const_size_word_set<kWordNoneMask, kNWords>(words_);
         return *this;
@@ -230,50 +247,103 @@ public:
         return *this;
     }
 
-    template <size_t Sz, typename TW, template <typename> typename TMT>
-    friend Bitset<Sz, TW, TMT> operator&(const Bitset<Sz, TW, TMT> &lhv,
-                                         const Bitset<Sz, TW, TMT> &rhv) noexcept
+    // Multi-operand intersection, nothing is written and every word is loaded once per operand.
+    // Operands are a range of pointers, static extent only to unroll internal cycles
+
+    /// Check if the intersection of all @p operands is not empty
+    template <typename TBitsets>
+    static bool and_any(TBitsets &&operands) noexcept
+    {
+        return and_scan_(std::span(std::forward<TBitsets>(operands)),
+                         [](size_t, const TWord *, size_t) { return true; });
+    }
+
+    /// Number of bits set in the intersection of all @p operands
+    template <typename TBitsets>
+    static size_t and_count(TBitsets &&operands) noexcept
+    {
+        size_t res{};
+        and_scan_(std::span(std::forward<TBitsets>(operands)),
+                  [&res](size_t, const TWord *words, size_t n)
+                  {
+                      for (size_t i = 0; i < n; ++i)
+                          res += std::popcount(words[i]);
+                      return false;
+                  });
+        return res;
+    }
+
+    /// Lowest bit set in the intersection of all @p operands
+    template <typename TBitsets>
+    static std::optional<size_t> and_first(TBitsets &&operands) noexcept
+    {
+        std::optional<size_t> res;
+        and_scan_(std::span(std::forward<TBitsets>(operands)),
+                  [&res](size_t word_i, const TWord *words, [[maybe_unused]] size_t n)
+                  {
+                      size_t i = 0;
+                      for (; !words[i]; ++i)
+                          assert(i + 1 < n); // chunk is reported only if non-zero
+                      res = (word_i + i) * kBitsPerWord + std::countr_zero(words[i]);
+                      return true;
+                  });
+        return res;
+    }
+
+    friend Bitset operator&(const Bitset &lhv, const Bitset &rhv) noexcept
     {
         Bitset tmp(lhv);
         tmp &= rhv;
         return tmp;
     }
 
-    template <size_t Sz, typename TW, template <typename> typename TMT>
-    friend Bitset<Sz, TW, TMT> operator|(const Bitset<Sz, TW, TMT> &lhv,
-                                         const Bitset<Sz, TW, TMT> &rhv) noexcept
+    friend Bitset operator|(const Bitset &lhv, const Bitset &rhv) noexcept
     {
         Bitset tmp(lhv);
         tmp |= rhv;
         return tmp;
     }
 
-    template <size_t Sz, typename TW, template <typename> typename TMT>
-    friend Bitset<Sz, TW, TMT> operator^(const Bitset<Sz, TW, TMT> &lhv,
-                                         const Bitset<Sz, TW, TMT> &rhv) noexcept
+    friend Bitset operator^(const Bitset &lhv, const Bitset &rhv) noexcept
     {
         Bitset tmp(lhv);
         tmp ^= rhv;
         return tmp;
     }
 
-    template <size_t Sz, typename TW, template <typename> typename TMT>
-    friend Bitset<Sz, TW, TMT> operator>>(const Bitset<Sz, TW, TMT> &v, size_t shift) noexcept
+    friend Bitset operator>>(const Bitset &v, size_t shift) noexcept
     {
-        Bitset tmp(shift);
+        Bitset tmp(v);
         tmp >>= shift;
         return tmp;
     }
 
-    template <size_t Sz, typename TW, template <typename> typename TMT>
-    friend Bitset<Sz, TW, TMT> operator<<(const Bitset<Sz, TW, TMT> &v, size_t shift) noexcept
+    friend Bitset operator<<(const Bitset &v, size_t shift) noexcept
     {
-        Bitset tmp(shift);
+        Bitset tmp(v);
         tmp <<= shift;
         return tmp;
     }
+
+private:
+    template <typename TBitset, size_t kNOperands, typename TOp>
+        requires (kNOperands > 0) &&
+                 (std::same_as<std::remove_const_t<TBitset>, Bitset>)
+    static bool and_scan_(std::span<TBitset*, kNOperands> operands, TOp &&op) noexcept
+    {
+        const TWord *op_words[kNOperands];
+        ALWAYS_UNROLL for (size_t op_i = 0; op_i < kNOperands; ++op_i)
+            op_words[op_i] = operands[op_i]->words_;
+        return MemoryTraits::template const_size_and_scan<kNWords, kNOperands>(op_words, std::forward<TOp>(op));
+    }
 };
 
 }
 
+template <size_t kSize, typename TWord, template <typename> typename TMemTraits>
+struct std::hash<hmbl::Bitset<kSize, TWord, TMemTraits>>
+{
+    size_t operator()(const hmbl::Bitset<kSize, TWord, TMemTraits> &v) const noexcept { return v.hash(); }
+};
+
 #endif // header guard
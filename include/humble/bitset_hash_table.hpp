@@ -0,0 +1,351 @@
+#ifndef LIBHUMBLE_CPP_BITSET_HASH_TABLE_HPP_
+#define LIBHUMBLE_CPP_BITSET_HASH_TABLE_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <immintrin.h>
+
+#include "posix/aligned_allocator.h"
+
+namespace hmbl
+{
+
+namespace detail
+{
+
+template <typename TKey, typename TMapped>
+struct BitsetHashMapSlot
+{
+    TKey    key;
+    TMapped value;
+};
+
+/// @brief Open addressing table with keys stored inline in aligned slots
+/// @details Slots are split into groups of 16, each slot has a control byte: empty, deleted or
+/// 7 bits of the key hash. A group is probed with one SSE2 compare, full keys are compared only
+/// on a control byte match. Groups are visited in triangular order, which covers all of them
+/// for a power of 2 group count
+template <typename TKey, typename TMapped, typename THash, typename TAllocator>
+    requires posix::CAlignedAllocator<TAllocator>
+class BitsetHashTable
+{
+protected:
+    static constexpr bool kIsMap = !std::is_void_v<TMapped>;
+
+    using Slot      = std::conditional_t<kIsMap, BitsetHashMapSlot<TKey, TMapped>, TKey>;
+    using Ctrl      = int8_t;
+    using SlotAlloc = typename TAllocator::template rebind<Slot>::other;
+    using CtrlAlloc = typename TAllocator::template rebind<Ctrl>::other;
+
+    static constexpr size_t kGroupSize    = sizeof(__m128i);
+    static constexpr size_t kNPos         = ~size_t(0);
+    static constexpr Ctrl   kCtrlEmpty    = -128;
+    static constexpr Ctrl   kCtrlDeleted  = -2; // full slots hold non-negative hash fragment
+
+    static_assert(TAllocator::alignment() >= kGroupSize); // control group is loaded aligned
+
+    Ctrl   *ctrl_{};
+    Slot   *slots_{};
+    size_t  capacity_{};    // 0 or power of 2 multiple of kGroupSize
+    size_t  size_{};
+    size_t  growth_left_{}; // insertions into empty slots before rehash
+
+    static const TKey & key_(const Slot &slot) noexcept
+    {
+        if constexpr (kIsMap)
+            return slot.key;
+        else
+            return slot;
+    }
+
+    static Ctrl   h2_(size_t hash) noexcept { return static_cast<Ctrl>(hash >> (sizeof(size_t) * 8 - 7)); }
+    static size_t max_load_(size_t capacity) noexcept { return capacity - capacity / 8; }
+
+    static uint32_t match_(const Ctrl *group, Ctrl v) noexcept
+    {
+        __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(v)));
+    }
+
+    // empty or deleted, both have the sign bit set
+    static uint32_t match_free_(const Ctrl *group) noexcept
+    {
+        return _mm_movemask_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(group)));
+    }
+
+    size_t find_(const TKey &key, size_t hash) const noexcept
+    {
+        if (!capacity_) [[unlikely]]
+            return kNPos;
+
+        const size_t ngroups = capacity_ / kGroupSize;
+        const Ctrl   h2      = h2_(hash);
+        for (size_t g = hash & (ngroups - 1), step = 1; step <= ngroups; g = (g + step++) & (ngroups - 1))
+        {
+            const Ctrl *group = ctrl_ + g * kGroupSize;
+            for (uint32_t m = match_(group, h2); m; m &= m - 1)
+            {
+                size_t i = g * kGroupSize + std::countr_zero(m);
+                if (key_(slots_[i]) == key) [[likely]]
+                    return i;
+            }
+            if (match_(group, kCtrlEmpty)) [[likely]]
+                return kNPos;
+        }
+        return kNPos;
+    }
+
+    // first free slot on the probe sequence, the table MUST have one
+    size_t find_free_(size_t hash) const noexcept
+    {
+        const size_t ngroups = capacity_ / kGroupSize;
+        for (size_t g = hash & (ngroups - 1), step = 1; ; g = (g + step++) & (ngroups - 1))
+        {
+            if (uint32_t m = match_free_(ctrl_ + g * kGroupSize))
+                return g * kGroupSize + std::countr_zero(m);
+        }
+    }
+
+    template <typename... TArgs>
+    std::pair<Slot*, bool> emplace_(const TKey &key, TArgs&&... args)
+    {
+        size_t hash = THash{}(key);
+        if (size_t i = find_(key, hash); i != kNPos)
+            return {slots_ + i, false};
+
+        if (!growth_left_) [[unlikely]]
+        {
+            // grow when really full, otherwise the same size rehash drops tombstones
+            rehash_(size_ + 1 > max_load_(capacity_) / 2 ? std::max(capacity_ * 2, kGroupSize) : capacity_);
+        }
+
+        size_t i = find_free_(hash);
+        if (ctrl_[i] == kCtrlEmpty)
+            --growth_left_;
+        if constexpr (kIsMap)
+            ::new (slots_ + i) Slot{key, TMapped(std::forward<TArgs>(args)...)};
+        else
+            ::new (slots_ + i) Slot(key);
+        ctrl_[i] = h2_(hash);
+        ++size_;
+        return {slots_ + i, true};
+    }
+
+    bool erase_(const TKey &key) noexcept
+    {
+        size_t i = find_(key, THash{}(key));
+        if (i == kNPos)
+            return false;
+
+        std::destroy_at(slots_ + i);
+        --size_;
+        // a group with an empty slot never made a probe sequence go further,
+        // so the slot may become empty instead of a tombstone
+        if (match_(ctrl_ + (i & ~(kGroupSize - 1)), kCtrlEmpty))
+        {
+            ctrl_[i] = kCtrlEmpty;
+            ++growth_left_;
+        }
+        else
+        {
+            ctrl_[i] = kCtrlDeleted;
+        }
+        return true;
+    }
+
+    void rehash_(size_t capacity)
+    {
+        assert(capacity >= kGroupSize && utils::is_pow_2(capacity));
+        assert(max_load_(capacity) >= size_);
+
+        // both arrays are allocated before the table changes, a bad_alloc leaves it intact
+        Ctrl *ctrl = CtrlAlloc().allocate(capacity);
+        Slot *slots;
+        try
+        {
+            slots = SlotAlloc().allocate(capacity);
+        }
+        catch (...)
+        {
+            CtrlAlloc().deallocate(ctrl, capacity);
+            throw;
+        }
+
+        Ctrl  *old_ctrl     = std::exchange(ctrl_, ctrl);
+        Slot  *old_slots    = std::exchange(slots_, slots);
+        size_t old_capacity = std::exchange(capacity_, capacity);
+        std::memset(ctrl_, kCtrlEmpty, capacity);
+
+        for (size_t i = 0; i < old_capacity; ++i)
+        {
+            if (old_ctrl[i] < 0)
+                continue;
+            size_t hash = THash{}(key_(old_slots[i]));
+            size_t j    = find_free_(hash);
+            ctrl_[j]    = h2_(hash);
+            ::new (slots_ + j) Slot(std::move(old_slots[i]));
+            std::destroy_at(old_slots + i);
+        }
+        growth_left_ = max_load_(capacity_) - size_;
+        release_(old_ctrl, old_slots, old_capacity);
+    }
+
+    static void release_(Ctrl *ctrl, Slot *slots, size_t capacity) noexcept
+    {
+        if (!capacity)
+            return;
+        CtrlAlloc().deallocate(ctrl, capacity);
+        SlotAlloc().deallocate(slots, capacity);
+    }
+
+    template <typename TFunc>
+    void for_each_(TFunc &&func) const
+    {
+        for (size_t i = 0; i < capacity_; ++i)
+        {
+            if (ctrl_[i] >= 0)
+                func(slots_[i]);
+        }
+    }
+
+public:
+    BitsetHashTable() = default;
+
+    BitsetHashTable(BitsetHashTable &&other) noexcept
+        : ctrl_{std::exchange(other.ctrl_, nullptr)}
+        , slots_{std::exchange(other.slots_, nullptr)}
+        , capacity_{std::exchange(other.capacity_, 0)}
+        , size_{std::exchange(other.size_, 0)}
+        , growth_left_{std::exchange(other.growth_left_, 0)}
+    {}
+
+    BitsetHashTable & operator=(BitsetHashTable &&other) noexcept
+    {
+        if (this != &other)
+        {
+            clear();
+            release_(ctrl_, slots_, capacity_);
+            ctrl_        = std::exchange(other.ctrl_, nullptr);
+            slots_       = std::exchange(other.slots_, nullptr);
+            capacity_    = std::exchange(other.capacity_, 0);
+            size_        = std::exchange(other.size_, 0);
+            growth_left_ = std::exchange(other.growth_left_, 0);
+        }
+        return *this;
+    }
+
+    BitsetHashTable(const BitsetHashTable & )             = delete;
+    BitsetHashTable & operator=(const BitsetHashTable & ) = delete;
+
+    ~BitsetHashTable()
+    {
+        clear();
+        release_(ctrl_, slots_, capacity_);
+    }
+
+    size_t size()     const noexcept { return size_; }
+    size_t capacity() const noexcept { return capacity_; }
+    bool   empty()    const noexcept { return !size_; }
+
+    /// Make room for @p n elements without rehashing
+    void reserve(size_t n)
+    {
+        size_t capacity = std::max(capacity_, kGroupSize);
+        while (max_load_(capacity) < n)
+            capacity *= 2;
+        if (capacity != capacity_)
+            rehash_(capacity);
+    }
+
+    void clear() noexcept
+    {
+        if (!capacity_)
+            return;
+        if constexpr (!std::is_trivially_destructible_v<Slot>)
+        {
+            for (size_t i = 0; i < capacity_; ++i)
+                if (ctrl_[i] >= 0)
+                    std::destroy_at(slots_ + i);
+        }
+        std::memset(ctrl_, kCtrlEmpty, capacity_);
+        size_        = 0;
+        growth_left_ = max_load_(capacity_);
+    }
+
+    bool contains(const TKey &key) const noexcept { return find_(key, THash{}(key)) != kNPos; }
+    bool erase(const TKey &key) noexcept { return erase_(key); }
+};
+
+} // namespace detail
+
+/// @brief Flat hash set of bitsets
+/// @tparam TKey Bitset type, hashed by @p THash and compared by its memory traits equality
+template <typename TKey,
+          typename THash      = std::hash<TKey>,
+          typename TAllocator = posix::AlignedAllocator<uint64_t, 64>>
+class BitsetHashSet : public detail::BitsetHashTable<TKey, void, THash, TAllocator>
+{
+    using Base = detail::BitsetHashTable<TKey, void, THash, TAllocator>;
+
+public:
+    /// @return true if @p key wasn't in the set
+    bool insert(const TKey &key) { return Base::emplace_(key).second; }
+
+    /// Call @p func for every key in unspecified order
+    template <typename TFunc>
+    void for_each(TFunc &&func) const { Base::for_each_(std::forward<TFunc>(func)); }
+};
+
+/// @brief Flat hash map keyed by bitsets, values are stored next to keys
+template <typename TKey,
+          typename TMapped,
+          typename THash      = std::hash<TKey>,
+          typename TAllocator = posix::AlignedAllocator<uint64_t, 64>>
+class BitsetHashMap : public detail::BitsetHashTable<TKey, TMapped, THash, TAllocator>
+{
+    using Base = detail::BitsetHashTable<TKey, TMapped, THash, TAllocator>;
+
+public:
+    /// Construct value from @p args if @p key is absent
+    /// @return value of @p key and true if it was inserted
+    template <typename... TArgs>
+    std::pair<TMapped*, bool> try_emplace(const TKey &key, TArgs&&... args)
+    {
+        auto [slot, inserted] = Base::emplace_(key, std::forward<TArgs>(args)...);
+        return {&slot->value, inserted};
+    }
+
+    TMapped & operator[](const TKey &key) { return *try_emplace(key).first; }
+
+    TMapped * find(const TKey &key) noexcept
+    {
+        size_t i = Base::find_(key, THash{}(key));
+        return i == Base::kNPos ? nullptr : &Base::slots_[i].value;
+    }
+
+    const TMapped * find(const TKey &key) const noexcept
+    {
+        return const_cast<BitsetHashMap*>(this)->find(key);
+    }
+
+    /// Call @p func(key, value) for every element in unspecified order
+    template <typename TFunc>
+    void for_each(TFunc &&func) const
+    {
+        Base::for_each_([&func](const auto &slot) { func(slot.key, slot.value); });
+    }
+};
+
+} // namespace hmbl
+
+#endif // header guard
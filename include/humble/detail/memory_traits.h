@@ -1,7 +1,14 @@
 #ifndef LIBHUMBLE_CPP_DETAIL_MEMORY_TRAITS_HPP_
 #define LIBHUMBLE_CPP_DETAIL_MEMORY_TRAITS_HPP_
 
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <immintrin.h>
 
 #include "humble/utils.hpp"
 
@@ -65,6 +72,234 @@ struct StaticMemoryTraits
         for (size_t i = 0; i < kDataSize; ++i)
             dst_v[i] = op(v1[i], v2[i]);
     }
+
+    /// Intersect @p kNOperands constant size arrays chunk by chunk without storing the result.
+    /// @p op(first_word_i, words, n) is called for chunks with a non-zero intersection and stops
+    /// the scan by returning true. Every word is loaded once per operand, a chunk stops loading
+    /// operands as soon as its intersection is empty
+    /// @return true if the scan was stopped by @p op
+    template <size_t kDataSize, size_t kNOperands, typename TOp>
+    static bool const_size_and_scan(const TWord *const ops[kNOperands], TOp &&op) noexcept
+    {
+#ifdef __AVX2__
+        using Vec = __m256i;
+        const auto load    = [](const TWord *p) { return _mm256_loadu_si256(reinterpret_cast<const Vec*>(p)); };
+        const auto and_    = [](Vec v1, Vec v2) { return _mm256_and_si256(v1, v2); };
+        const auto store   = [](TWord *p, Vec v) { _mm256_store_si256(reinterpret_cast<Vec*>(p), v); };
+        const auto is_zero = [](Vec v) { return !!_mm256_testz_si256(v, v); };
+#else
+        using Vec = __m128i;
+        const auto load    = [](const TWord *p) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(p)); };
+        const auto and_    = [](Vec v1, Vec v2) { return _mm_and_si128(v1, v2); };
+        const auto store   = [](TWord *p, Vec v) { _mm_store_si128(reinterpret_cast<Vec*>(p), v); };
+        const auto is_zero = [](Vec v)
+        {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF;
+        };
+#endif
+        constexpr size_t kChunk    = sizeof(Vec) / sizeof(TWord);
+        constexpr size_t kChunkEnd  = kDataSize - kDataSize % kChunk;
+
+        alignas(Vec) TWord chunk[kChunk];
+        for (size_t i = 0; i < kChunkEnd; i += kChunk)
+        {
+            Vec acc = load(ops[0] + i);
+            ALWAYS_UNROLL for (size_t op_i = 1; op_i < kNOperands; ++op_i)
+            {
+                if (is_zero(acc))
+                    break;
+                acc = and_(acc, load(ops[op_i] + i));
+            }
+            if (is_zero(acc)) [[likely]]
+                continue;
+            store(chunk, acc);
+            if (op(i, chunk, kChunk))
+                return true;
+        }
+
+        if constexpr (kChunkEnd < kDataSize)
+        {
+            for (size_t i = kChunkEnd; i < kDataSize; ++i)
+            {
+                TWord w = ops[0][i];
+                ALWAYS_UNROLL for (size_t op_i = 1; op_i < kNOperands; ++op_i)
+                    w &= ops[op_i][i];
+                if (w && op(i, &w, 1))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    /// Hash of the constant size array: CRC32C over two interleaved word streams with SSE4.2,
+    /// multiply-xorshift fold otherwise, both finished by a 64 bit avalanche
+    template <size_t kDataSize>
+    static size_t const_size_hash(const TWord v[kDataSize]) noexcept
+    {
+        uint64_t h;
+#ifdef __SSE4_2__
+        uint64_t h0 = kDataSize, h1 = ~uint64_t(kDataSize);
+        size_t i = 0;
+        for (; i + 1 < kDataSize; i += 2)
+        {
+            // independent streams hide the crc32 latency
+            h0 = _mm_crc32_u64(h0, static_cast<uint64_t>(v[i]));
+            h1 = _mm_crc32_u64(h1, static_cast<uint64_t>(v[i + 1]));
+        }
+        if (i < kDataSize)
+            h0 = _mm_crc32_u64(h0, static_cast<uint64_t>(v[i]));
+        h = (h0 << 32) | h1;
+#else
+        constexpr uint64_t kMul = 0x9E3779B97F4A7C15;
+        h = kDataSize;
+        for (size_t i = 0; i < kDataSize; ++i)
+        {
+            h = (h ^ static_cast<uint64_t>(v[i])) * kMul;
+            h ^= h >> 32;
+        }
+#endif
+        // murmur3 finalizer
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCD;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    /// Shift the constant size array toward lower indexes by @p wshift words and @p bshift bits,
+    /// vacated high words are zeroed. Requires @p wshift < kDataSize and @p bshift < bits per word
+    template <size_t kDataSize>
+    static void const_size_shift_down(TWord v[kDataSize], size_t wshift, size_t bshift) noexcept
+    {
+        assert(wshift < kDataSize && bshift < kWordBits);
+        const size_t n = kDataSize - wshift; // words receiving data
+        if (!bshift)
+        {
+            std::memmove(v, v + wshift, n * sizeof(TWord));
+        }
+        else
+        {
+            // v[i] = funnel(v[i + wshift + 1] : v[i + wshift]) >> bshift, vectors read a word ahead
+            size_t i = 0;
+            if constexpr (sizeof(TWord) == sizeof(uint64_t))
+            {
+                const __m128i sh  = _mm_cvtsi64_si128(bshift);
+                const __m128i osh = _mm_cvtsi64_si128(kWordBits - bshift);
+#ifdef __AVX2__
+                for (; i + 4 < n; i += 4)
+                {
+                    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i + wshift));
+                    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i + wshift + 1));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i),
+                                        _mm256_or_si256(_mm256_srl_epi64(lo, sh), _mm256_sll_epi64(hi, osh)));
+                }
+#endif
+                for (; i + 2 < n; i += 2)
+                {
+                    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i + wshift));
+                    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i + wshift + 1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i),
+                                     _mm_or_si128(_mm_srl_epi64(lo, sh), _mm_sll_epi64(hi, osh)));
+                }
+            }
+            for (; i + 1 < n; ++i)
+                v[i] = (v[i + wshift] >> bshift) | (v[i + wshift + 1] << (kWordBits - bshift));
+            v[n - 1] = v[kDataSize - 1] >> bshift;
+        }
+        word_set<TWord(0)>(v + n, wshift);
+    }
+
+    /// Shift the constant size array toward higher indexes by @p wshift words and @p bshift bits,
+    /// vacated low words are zeroed. Requires @p wshift < kDataSize and @p bshift < bits per word
+    template <size_t kDataSize>
+    static void const_size_shift_up(TWord v[kDataSize], size_t wshift, size_t bshift) noexcept
+    {
+        assert(wshift < kDataSize && bshift < kWordBits);
+        if (!bshift)
+        {
+            std::memmove(v + wshift, v, (kDataSize - wshift) * sizeof(TWord));
+        }
+        else
+        {
+            // v[i - 1] = funnel(v[i - 1 - wshift] : v[i - 2 - wshift]) << bshift, descending
+            size_t i = kDataSize; // end of not yet processed words
+            if constexpr (sizeof(TWord) == sizeof(uint64_t))
+            {
+                const __m128i sh  = _mm_cvtsi64_si128(bshift);
+                const __m128i osh = _mm_cvtsi64_si128(kWordBits - bshift);
+#ifdef __AVX2__
+                for (; i >= wshift + 5; i -= 4)
+                {
+                    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i - 4 - wshift));
+                    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i - 5 - wshift));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i - 4),
+                                        _mm256_or_si256(_mm256_sll_epi64(hi, sh), _mm256_srl_epi64(lo, osh)));
+                }
+#endif
+                for (; i >= wshift + 3; i -= 2)
+                {
+                    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i - 2 - wshift));
+                    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i - 3 - wshift));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i - 2),
+                                     _mm_or_si128(_mm_sll_epi64(hi, sh), _mm_srl_epi64(lo, osh)));
+                }
+            }
+            for (; i > wshift + 1; --i)
+                v[i - 1] = (v[i - 1 - wshift] << bshift) | (v[i - 2 - wshift] >> (kWordBits - bshift));
+            v[wshift] = v[0] << bshift;
+        }
+        word_set<TWord(0)>(v, wshift);
+    }
+
+    /// Compile time version of const_size_shift_down, fully unrolled
+    template <size_t kDataSize, size_t kWShift, size_t kBShift>
+        requires (kWShift < kDataSize) && (kBShift < std::numeric_limits<TWord>::digits)
+    static constexpr void const_size_shift_down(TWord v[kDataSize]) noexcept
+    {
+        [v]<size_t... kI>(std::index_sequence<kI...>)
+        {
+            ((v[kI] = shifted_down_word_<kDataSize, kWShift, kBShift, kI>(v)), ...);
+        }(std::make_index_sequence<kDataSize>{});
+    }
+
+    /// Compile time version of const_size_shift_up, fully unrolled
+    template <size_t kDataSize, size_t kWShift, size_t kBShift>
+        requires (kWShift < kDataSize) && (kBShift < std::numeric_limits<TWord>::digits)
+    static constexpr void const_size_shift_up(TWord v[kDataSize]) noexcept
+    {
+        [v]<size_t... kI>(std::index_sequence<kI...>)
+        {
+            // descending order, so every source word is read before being overwritten
+            ((v[kDataSize - 1 - kI] = shifted_up_word_<kDataSize, kWShift, kBShift, kDataSize - 1 - kI>(v)), ...);
+        }(std::make_index_sequence<kDataSize>{});
+    }
+
+private:
+    static constexpr size_t kWordBits = std::numeric_limits<TWord>::digits;
+
+    template <size_t kDataSize, size_t kWShift, size_t kBShift, size_t kI>
+    static constexpr TWord shifted_down_word_(const TWord v[kDataSize]) noexcept
+    {
+        constexpr size_t kSrc = kI + kWShift;
+        if constexpr (kSrc >= kDataSize)
+            return 0;
+        else if constexpr (!kBShift || kSrc + 1 == kDataSize)
+            return v[kSrc] >> kBShift;
+        else
+            return (v[kSrc] >> kBShift) | (v[kSrc + 1] << (kWordBits - kBShift));
+    }
+
+    template <size_t kDataSize, size_t kWShift, size_t kBShift, size_t kI>
+    static constexpr TWord shifted_up_word_(const TWord v[kDataSize]) noexcept
+    {
+        if constexpr (kI < kWShift)
+            return 0;
+        else if constexpr (!kBShift || kI == kWShift)
+            return v[kI - kWShift] << kBShift;
+        else
+            return (v[kI - kWShift] << kBShift) | (v[kI - kWShift - 1] >> (kWordBits - kBShift));
+    }
 };
 
 } // namespace hmbl::detail
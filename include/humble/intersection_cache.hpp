@@ -0,0 +1,312 @@
+#ifndef LIBHUMBLE_CPP_INTERSECTION_CACHE_H_
+#define LIBHUMBLE_CPP_INTERSECTION_CACHE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "posix/aligned_allocator.h"
+#include "bitset_hash_table.hpp"
+#include "sparse_dynamic_bitset.hpp"
+
+namespace hmbl
+{
+
+/// @brief Concurrent size bounded LRU cache of SparseDynamicBitset intersections
+/// @tparam TBitset A SparseDynamicBitset
+/// @tparam TAllocator A stateless allocator aligned to a cache line at least, charged with all
+/// memory of the cache
+/// @details A key is the sorted (id, version) pairs of the operands, so the operand order doesn't
+/// matter and a changed bitset misses, its stale entries just age out. Shards, each an LRU list and
+/// a BitsetHashMap under its own mutex, split the byte bound. Results are computed outside the lock
+/// and shared, so an evicted one stays valid for its holders. More than kMaxOperands operands
+/// bypass the cache
+template <typename TBitset, typename TAllocator = posix::AlignedAllocator<uint64_t, 64>>
+    requires posix::CAlignedAllocator<TAllocator>
+class IntersectionCache
+{
+    template <typename T>
+    using Alloc = typename TAllocator::template rebind<T>::other;
+
+public:
+    static constexpr size_t kMaxOperands = kMaxAndAnyOperands;
+
+    using Positions = std::vector<size_t, Alloc<size_t>>;
+
+    struct Stats
+    {
+        size_t hits;
+        size_t misses;
+        size_t evictions; // entries dropped for the byte bound
+        size_t bypassed;  // calls with too many operands to be keyed
+        size_t entries;
+        size_t bytes;     // accounted by entries, results and key copies
+
+        double hit_rate() const noexcept { return hits + misses ? double(hits) / double(hits + misses) : 0; }
+    };
+
+private:
+    struct Key
+    {
+        std::array<std::pair<uint64_t, uint64_t>, kMaxOperands> operands{}; // id and version, sorted
+        size_t                                                  size{};
+
+        bool operator==(const Key &) const noexcept = default; // unused pairs stay zero
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const noexcept
+        {
+            uint64_t h = key.size;
+            for (size_t i = 0; i < key.size; ++i)
+                h = mix_(h ^ mix_(key.operands[i].first * 0x9E3779B97F4A7C15ull + key.operands[i].second));
+            return h;
+        }
+    };
+
+    // and_any() caches the first position only, intersect() all of them
+    struct Entry
+    {
+        std::optional<size_t>    first;
+        std::optional<Positions> positions;
+    };
+
+    using LruList = std::list<Key, Alloc<Key>>;
+
+    struct Slot
+    {
+        std::shared_ptr<const Entry> entry;
+        typename LruList::iterator   lru;
+        size_t                       bytes;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex                                         mutex;
+        LruList                                            lru;   // most recent first
+        BitsetHashMap<Key, Slot, KeyHash, TAllocator>      index;
+        size_t                                             bytes{};
+    };
+    static_assert(TAllocator::alignment() >= alignof(Shard)); // shards are allocated by it
+
+    static constexpr size_t kEntryOverhead = 2 * sizeof(Key) + sizeof(Slot) + sizeof(Entry) + 64; // + refcounts, list links
+
+    Shard              *shards_;
+    size_t              nshards_;
+    size_t              shard_bytes_; // bound of a shard
+    std::atomic<size_t> hits_{};
+    std::atomic<size_t> misses_{};
+    std::atomic<size_t> evictions_{};
+    std::atomic<size_t> bypassed_{};
+
+public:
+    /// @param max_bytes Bound of the accounted bytes, an entry larger than its shard share isn't kept
+    /// @param shards Independently locked parts, a power of 2
+    explicit IntersectionCache(size_t max_bytes, size_t shards = 16)
+        : shards_{Alloc<Shard>().allocate(shards)}
+        , nshards_{shards}
+        , shard_bytes_{max_bytes / shards}
+    {
+        assert(utils::is_pow_2(shards));
+        for (size_t i = 0; i < nshards_; ++i)
+            ::new (shards_ + i) Shard{};
+    }
+
+    ~IntersectionCache()
+    {
+        std::destroy_n(shards_, nshards_);
+        Alloc<Shard>().deallocate(shards_, nshards_);
+    }
+
+    IntersectionCache(const IntersectionCache & )             = delete;
+    IntersectionCache & operator=(const IntersectionCache & ) = delete;
+
+    /// Cached TBitset::and_any() of the operand set
+    std::optional<size_t> and_any(std::span<const TBitset *const> operands)
+    {
+        assert(!operands.empty());
+        auto key = key_(operands);
+        if (!key)
+        {
+            bypassed_.fetch_add(1, std::memory_order_relaxed);
+            return first_(operands);
+        }
+        if (auto entry = find_(*key, false))
+            return entry->first;
+
+        auto entry = std::allocate_shared<Entry>(Alloc<Entry>(), Entry{and_any_dynamic<TBitset>(operands), std::nullopt});
+        insert_(*key, entry, kEntryOverhead);
+        return entry->first;
+    }
+
+    /// Cached positions of the intersection in increasing order, may outlive its entry
+    std::shared_ptr<const Positions> intersect(std::span<const TBitset *const> operands)
+    {
+        assert(!operands.empty());
+        auto key = key_(operands);
+        if (key)
+        {
+            if (auto entry = find_(*key, true))
+                return {entry, &*entry->positions};
+        }
+        else
+        {
+            bypassed_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Positions positions;
+        scan_(operands, [&](size_t pos) { positions.push_back(pos); return true; });
+        positions.shrink_to_fit();
+        const size_t bytes = kEntryOverhead + positions.capacity() * sizeof(size_t);
+        std::optional<size_t> first;
+        if (!positions.empty())
+            first = positions.front();
+        auto entry = std::allocate_shared<Entry>(Alloc<Entry>(), Entry{first, std::move(positions)});
+        if (key)
+            insert_(*key, entry, bytes); // replaces a first position only entry
+        return {entry, &*entry->positions};
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < nshards_; ++i)
+        {
+            std::lock_guard lock(shards_[i].mutex);
+            shards_[i].index.clear();
+            shards_[i].lru.clear();
+            shards_[i].bytes = 0;
+        }
+    }
+
+    /// May be called from any thread, the counters are read one by one
+    Stats stats() const
+    {
+        Stats res{hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed),
+                  evictions_.load(std::memory_order_relaxed), bypassed_.load(std::memory_order_relaxed), 0, 0};
+        for (size_t i = 0; i < nshards_; ++i)
+        {
+            std::lock_guard lock(shards_[i].mutex);
+            res.entries += shards_[i].index.size();
+            res.bytes   += shards_[i].bytes;
+        }
+        return res;
+    }
+
+private:
+    static uint64_t mix_(uint64_t h) noexcept
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        return h ^ (h >> 33);
+    }
+
+    static std::optional<Key> key_(std::span<const TBitset *const> operands) noexcept
+    {
+        if (std::size(operands) > kMaxOperands)
+            return std::nullopt;
+        Key key;
+        key.size = std::size(operands);
+        for (size_t i = 0; i < key.size; ++i)
+            key.operands[i] = {operands[i]->id(), operands[i]->version()};
+        std::sort(std::begin(key.operands), std::begin(key.operands) + key.size);
+        return key;
+    }
+
+    Shard & shard_(const Key &key) const noexcept { return shards_[(KeyHash{}(key) >> 32) & (nshards_ - 1)]; }
+
+    std::shared_ptr<const Entry> find_(const Key &key, bool positions)
+    {
+        auto &shard = shard_(key);
+        std::lock_guard lock(shard.mutex);
+        auto *slot = shard.index.find(key);
+        if (!slot || (positions && !slot->entry->positions))
+        {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+        shard.lru.splice(std::begin(shard.lru), shard.lru, slot->lru);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return slot->entry;
+    }
+
+    void insert_(const Key &key, std::shared_ptr<const Entry> entry, size_t bytes)
+    {
+        if (bytes > shard_bytes_)
+            return;
+        auto &shard = shard_(key);
+        std::lock_guard lock(shard.mutex);
+        if (auto *slot = shard.index.find(key))
+        {
+            // computed twice by racing misses or upgraded to positions
+            shard.bytes += bytes - slot->bytes;
+            slot->entry = std::move(entry);
+            slot->bytes = bytes;
+            shard.lru.splice(std::begin(shard.lru), shard.lru, slot->lru);
+        }
+        else
+        {
+            shard.lru.push_front(key);
+            try
+            {
+                shard.index.try_emplace(key, Slot{std::move(entry), std::begin(shard.lru), bytes});
+            }
+            catch (...)
+            {
+                shard.lru.pop_front();
+                throw;
+            }
+            shard.bytes += bytes;
+        }
+        while (shard.bytes > shard_bytes_)
+        {
+            auto *victim = shard.index.find(shard.lru.back());
+            shard.bytes -= victim->bytes;
+            shard.index.erase(shard.lru.back());
+            shard.lru.pop_back();
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::optional<size_t> first_(std::span<const TBitset *const> operands) const
+    {
+        std::optional<size_t> res;
+        scan_(operands, [&](size_t pos) { res = pos; return false; });
+        return res;
+    }
+
+    // the rarest operand is walked, the others probed in increasing popcount order
+    template <typename TFunc>
+    static void scan_(std::span<const TBitset *const> operands, TFunc &&func)
+    {
+        std::vector<std::pair<size_t, const TBitset *>> sorted;
+        for (auto *op : operands)
+            sorted.emplace_back(op->count(), op);
+        std::sort(std::begin(sorted), std::end(sorted));
+        std::vector<typename TBitset::Cursor> cursors;
+        for (size_t i = 1; i < std::size(sorted); ++i)
+            cursors.push_back(sorted[i].second->cursor());
+        sorted.front().second->for_each([&](size_t pos)
+        {
+            for (auto &cursor : cursors)
+                if (!cursor.test(pos))
+                    return true;
+            return func(pos);
+        });
+    }
+};
+
+}
+
+#endif // LIBHUMBLE_CPP_INTERSECTION_CACHE_H_
@@ -2,9 +2,12 @@
 #define HUMBLE_ALIGNED_ALLOCATOR_H_
 
 #include <cstddef>
+#include <cstring>
 #include <concepts>
+#include <new>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
 
 #include "humble/utils.hpp"
 
@@ -27,6 +30,11 @@ struct AlignedAllocator
         using other = AlignedAllocator<U, kAlignment>;
     };
 
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, kAlignment> & /*other*/) noexcept {}
+
     static constexpr size_t alignment() noexcept { return kAlignment; }
 
     value_type * allocate(size_t n)
@@ -39,10 +47,20 @@ struct AlignedAllocator
         return static_cast<value_type *>(p);
     }
 
+    value_type * allocate_zeroed(size_t n)
+    {
+        auto *p = allocate(n);
+        std::memset(p, 0, sizeof(value_type) * n);
+        return p;
+    }
+
     void deallocate(value_type * p, size_t /*n*/) noexcept
     {
         free(p);
     }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, kAlignment> & /*other*/) const noexcept { return true; }
 };
 
 template <typename TAllocator>
@@ -52,6 +70,72 @@ concept CAlignedAllocator = requires
     { TAllocator::alignment() } noexcept;
 };
 
+/// Allocator able to hand out zero filled memory cheaper than allocate() and memset
+template <typename TAllocator>
+concept CZeroedAllocator = requires(TAllocator alloc, size_t n)
+{
+    { alloc.allocate_zeroed(n) } -> std::same_as<typename TAllocator::value_type *>;
+};
+
+template <typename TAllocator>
+auto * allocate_zeroed(TAllocator &alloc, size_t n)
+{
+    if constexpr (CZeroedAllocator<TAllocator>)
+    {
+        return alloc.allocate_zeroed(n);
+    }
+    else
+    {
+        auto *p = alloc.allocate(n);
+        std::memset(p, 0, sizeof(*p) * n);
+        return p;
+    }
+}
+
+namespace detail
+{
+
+/// @brief Allocator adaptor for containers of trivial types which MUST start zeroed
+/// @details Memory is requested zero filled and value initialization of trivial elements is
+/// skipped, e.g. std::vector::resize() doesn't write the memory at all. So it's only for
+/// containers which never shrink: an element constructed again after a shrink, e.g. by
+/// resize(0) and resize(n), keeps its stale value instead of zero
+template <typename TAllocator>
+struct ZeroInitAllocator : TAllocator
+{
+    using value_type = typename TAllocator::value_type;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = ZeroInitAllocator<typename TAllocator::template rebind<U>::other>;
+    };
+
+    ZeroInitAllocator() = default;
+
+    template <typename TOther>
+        requires std::constructible_from<TAllocator, const TOther &>
+    ZeroInitAllocator(const TOther &other) noexcept : TAllocator(other) {}
+
+    value_type * allocate(size_t n)
+    {
+        return posix::allocate_zeroed(static_cast<TAllocator &>(*this), n);
+    }
+
+    value_type * allocate_zeroed(size_t n) { return allocate(n); }
+
+    template <typename U, typename... TArgs>
+    void construct(U *p, TArgs&&... args)
+    {
+        if constexpr (sizeof...(TArgs) == 0 && std::is_trivially_default_constructible_v<U>)
+            ::new (static_cast<void *>(p)) U; // already zero
+        else
+            ::new (static_cast<void *>(p)) U(std::forward<TArgs>(args)...);
+    }
+};
+
+} // namespace detail
+
 }
 
 #endif // HUMBLE_ALIGNED_ALLOCATOR_H_
\ No newline at end of file
@@ -0,0 +1,168 @@
+#ifndef HUMBLE_ARENA_ALLOCATOR_H_
+#define HUMBLE_ARENA_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#include "humble/utils.hpp"
+
+namespace hmbl::posix
+{
+
+/// @brief Monotonic memory resource with bump allocation from large aligned blocks
+/// @details Nothing is freed until reset() or release(). reset() rewinds the arena and merges
+/// the blocks into one, so a steady workload ends up with a single block and no system calls
+class AlignedArena
+{
+public:
+    static constexpr size_t kBlockAlignment = 4096; // max alignment supported by the arena
+
+private:
+    struct Block
+    {
+        Block  *next;
+        size_t  size; // including the header
+    };
+
+    static constexpr size_t kHeaderSize = utils::align_up<size_t, alignof(std::max_align_t)>(sizeof(Block));
+
+    Block     *head_{};    // block being filled, older blocks follow
+    uintptr_t  cur_{};
+    uintptr_t  end_{};
+    size_t     block_size_;
+
+public:
+    explicit AlignedArena(size_t block_size = size_t(1) << 20)
+        : block_size_{block_size}
+    {}
+
+    ~AlignedArena() { release(); }
+
+    AlignedArena(const AlignedArena & )             = delete;
+    AlignedArena & operator=(const AlignedArena & ) = delete;
+
+    void * allocate(size_t bytes, size_t alignment)
+    {
+        assert(utils::is_pow_2(alignment) && alignment <= kBlockAlignment);
+        uintptr_t p = (cur_ + alignment - 1) & ~(alignment - 1);
+        if (p + bytes > end_ || !head_) [[unlikely]]
+        {
+            add_block_(bytes + alignment);
+            p = (cur_ + alignment - 1) & ~(alignment - 1);
+        }
+        cur_ = p + bytes;
+        return reinterpret_cast<void *>(p);
+    }
+
+    /// Rewind the arena, all allocated memory becomes invalid
+    void reset() noexcept
+    {
+        if (!head_)
+            return;
+        if (head_->next)
+        {
+            // merge blocks, so the next cycle of the same size fits into one
+            size_t size{};
+            for (auto *b = head_; b; b = b->next)
+                size += b->size;
+            release();
+            void *p;
+            if (posix_memalign(&p, kBlockAlignment, size))
+                return; // will be retried by the next allocate
+            head_ = ::new (p) Block{nullptr, size};
+        }
+        cur_ = reinterpret_cast<uintptr_t>(head_) + kHeaderSize;
+        end_ = reinterpret_cast<uintptr_t>(head_) + head_->size;
+    }
+
+    /// Free all blocks
+    void release() noexcept
+    {
+        while (head_)
+            free(std::exchange(head_, head_->next));
+        cur_ = end_ = 0;
+    }
+
+    /// Total size of the blocks owned by the arena
+    size_t capacity() const noexcept
+    {
+        size_t size{};
+        for (auto *b = head_; b; b = b->next)
+            size += b->size;
+        return size;
+    }
+
+private:
+    void add_block_(size_t min_payload)
+    {
+        size_t size = std::max(block_size_, min_payload + kHeaderSize);
+        void *p;
+        if (posix_memalign(&p, kBlockAlignment, size))
+        {
+            throw std::bad_alloc();
+        }
+        head_ = ::new (p) Block{head_, size};
+        cur_  = reinterpret_cast<uintptr_t>(head_) + kHeaderSize;
+        end_  = reinterpret_cast<uintptr_t>(head_) + size;
+    }
+};
+
+/// @brief Aligned allocator drawing memory from an AlignedArena
+/// @tparam T An allocated data type
+/// @tparam kAlignment A given alignment
+/// @details Satisfies Allocator requirements, deallocate() is a no-op and memory
+/// is returned by AlignedArena::reset(). Copies and rebinds share the arena
+template <typename T, size_t kAlignment = 16>
+class ArenaAllocator
+{
+    static_assert(kAlignment <= AlignedArena::kBlockAlignment);
+
+    AlignedArena *arena_;
+
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = ArenaAllocator<U, kAlignment>;
+    };
+
+    explicit ArenaAllocator(AlignedArena &arena) noexcept : arena_{&arena} {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U, kAlignment> &other) noexcept : arena_{other.arena()} {}
+
+    static constexpr size_t alignment() noexcept { return kAlignment; }
+
+    AlignedArena * arena() const noexcept { return arena_; }
+
+    value_type * allocate(size_t n)
+    {
+        return static_cast<value_type *>(arena_->allocate(sizeof(value_type) * n, kAlignment));
+    }
+
+    value_type * allocate_zeroed(size_t n)
+    {
+        auto *p = allocate(n);
+        std::memset(p, 0, sizeof(value_type) * n); // blocks are reused after reset()
+        return p;
+    }
+
+    void deallocate(value_type * /*p*/, size_t /*n*/) noexcept {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U, kAlignment> &other) const noexcept
+    {
+        return arena_ == other.arena();
+    }
+};
+
+}
+
+#endif // HUMBLE_ARENA_ALLOCATOR_H_
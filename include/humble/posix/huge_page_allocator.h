@@ -0,0 +1,130 @@
+#ifndef HUMBLE_HUGE_PAGE_ALLOCATOR_H_
+#define HUMBLE_HUGE_PAGE_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "humble/utils.hpp"
+
+namespace hmbl::posix
+{
+
+namespace detail
+{
+
+inline constexpr size_t kHugePageSize = size_t(1) << 21; // 2 MB
+
+/// Map @p size bytes (multiple of kHugePageSize) backed by huge pages if possible:
+/// explicit hugetlb pages first, then a huge page aligned mapping advised for transparent huge pages
+/// @return nullptr on failure
+inline void * huge_page_map(size_t size) noexcept
+{
+    constexpr int kProt  = PROT_READ | PROT_WRITE;
+    constexpr int kFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+    if (void *p = ::mmap(nullptr, size, kProt, kFlags | MAP_HUGETLB, -1, 0); p != MAP_FAILED)
+        return p;
+#endif
+    // no reserved hugetlb pages: over map and trim to get a 2 MB aligned range
+    void *raw = ::mmap(nullptr, size + kHugePageSize, kProt, kFlags, -1, 0);
+    if (raw == MAP_FAILED)
+        return nullptr;
+
+    auto begin   = reinterpret_cast<uintptr_t>(raw);
+    auto aligned = (begin + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    if (aligned != begin)
+        ::munmap(raw, aligned - begin);
+    if (size_t tail = begin + size + kHugePageSize - (aligned + size))
+        ::munmap(reinterpret_cast<void *>(aligned + size), tail);
+
+    auto *p = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+    ::madvise(p, size, MADV_HUGEPAGE); // just a hint, small pages are fine if THP is off
+#endif
+    return p;
+}
+
+} // namespace detail
+
+/// @brief Aligned allocator backing large allocations with 2 MB pages
+/// @tparam T An allocated data type
+/// @tparam kAlignment A given alignment
+/// @tparam kMinHugeSize Allocations of at least this size in bytes are mapped with huge pages
+/// @details Satisfies Allocator requirements. Small allocations go to posix_memalign,
+/// large ones are rounded up to 2 MB and mapped with MAP_HUGETLB, falling back to
+/// madvise(MADV_HUGEPAGE) when no hugetlb pages are reserved. The path is selected by the
+/// size only, so deallocate() finds it from @p n
+template <typename T, size_t kAlignment = 16, size_t kMinHugeSize = detail::kHugePageSize>
+struct HugePageAllocator
+{
+    static_assert(utils::is_pow_2(kAlignment) && kAlignment <= detail::kHugePageSize);
+
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = HugePageAllocator<U, kAlignment, kMinHugeSize>;
+    };
+
+    HugePageAllocator() = default;
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U, kAlignment, kMinHugeSize> & /*other*/) noexcept {}
+
+    static constexpr size_t alignment() noexcept { return kAlignment; }
+
+    value_type * allocate(size_t n)
+    {
+        size_t size = sizeof(value_type) * n;
+        void *p;
+        if (is_huge_(size))
+        {
+            p = detail::huge_page_map(mapped_size_(size));
+            if (!p)
+                throw std::bad_alloc();
+        }
+        else if (posix_memalign(&p, kAlignment, size))
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<value_type *>(p);
+    }
+
+    /// Huge allocations are fresh anonymous mappings, which the kernel zero fills on first touch
+    value_type * allocate_zeroed(size_t n)
+    {
+        auto *p = allocate(n);
+        if (size_t size = sizeof(value_type) * n; !is_huge_(size))
+            std::memset(p, 0, size);
+        return p;
+    }
+
+    void deallocate(value_type * p, size_t n) noexcept
+    {
+        size_t size = sizeof(value_type) * n;
+        if (is_huge_(size))
+            ::munmap(p, mapped_size_(size));
+        else
+            free(p);
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U, kAlignment, kMinHugeSize> & /*other*/) const noexcept { return true; }
+
+private:
+    static constexpr bool   is_huge_(size_t size)     noexcept { return size >= kMinHugeSize; }
+    static constexpr size_t mapped_size_(size_t size) noexcept
+    {
+        return utils::align_up<size_t, detail::kHugePageSize>(size);
+    }
+};
+
+}
+
+#endif // HUMBLE_HUGE_PAGE_ALLOCATOR_H_
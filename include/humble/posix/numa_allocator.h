@@ -0,0 +1,242 @@
+#ifndef HUMBLE_NUMA_ALLOCATOR_H_
+#define HUMBLE_NUMA_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "humble/utils.hpp"
+
+namespace hmbl::posix
+{
+
+namespace numa
+{
+
+inline constexpr size_t kMaxNodes     = 1024;
+inline constexpr size_t kMaskWordBits = sizeof(unsigned long) * 8;
+
+using NodeMask = unsigned long[kMaxNodes / kMaskWordBits];
+
+/// Nodes the process may allocate memory on, sorted. Just {0} if the kernel can't tell
+inline const std::vector<unsigned> & nodes() noexcept
+{
+    static const std::vector<unsigned> kNodes = []
+    {
+        std::vector<unsigned> res;
+        NodeMask mask{};
+        // maxnode is the mask bit size plus one by the syscall convention
+        if (::syscall(SYS_get_mempolicy, nullptr, mask, kMaxNodes + 1, nullptr, MPOL_F_MEMS_ALLOWED) == 0)
+        {
+            for (size_t wi = 0; wi < std::size(mask); ++wi)
+                for (auto w = mask[wi]; w; w &= w - 1)
+                    res.push_back(wi * kMaskWordBits + std::countr_zero(w));
+        }
+        if (res.empty())
+            res.push_back(0);
+        return res;
+    }();
+    return kNodes;
+}
+
+inline bool is_numa() noexcept { return nodes().size() > 1; }
+
+/// Node of the cpu the calling thread runs on now
+inline unsigned current_node() noexcept
+{
+    unsigned cpu{}, node{};
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        return nodes().front();
+    return node;
+}
+
+} // namespace numa
+
+/// Where pages of an allocation go, applied by mbind before the first touch
+struct NumaPlacement
+{
+    enum class Kind : uint8_t
+    {
+        kLocal,      // node of the thread touching a page first, the kernel default made explicit
+        kNode,       // strictly the given node
+        kInterleave, // round robin over all allowed nodes
+    };
+
+    Kind     kind{Kind::kLocal};
+    unsigned node{};
+
+    static constexpr NumaPlacement local()             noexcept { return {Kind::kLocal, 0}; }
+    static constexpr NumaPlacement on_node(unsigned n) noexcept { return {Kind::kNode, n}; }
+    static constexpr NumaPlacement interleaved()       noexcept { return {Kind::kInterleave, 0}; }
+
+    bool operator==(const NumaPlacement &) const noexcept = default;
+
+    /// Apply to the page aligned range, a no-op on single node machines or if the kernel refuses
+    void apply(void *p, size_t size) const noexcept
+    {
+        if (!numa::is_numa())
+            return;
+
+        numa::NodeMask mask{};
+        int mode{};
+        switch (kind)
+        {
+        case Kind::kLocal:
+            mode = MPOL_LOCAL;
+            break;
+        case Kind::kNode:
+            if (node >= numa::kMaxNodes)
+                return;
+            mode = MPOL_BIND;
+            mask[node / numa::kMaskWordBits] |= 1ul << (node % numa::kMaskWordBits);
+            break;
+        case Kind::kInterleave:
+            mode = MPOL_INTERLEAVE;
+            for (auto n : numa::nodes())
+                mask[n / numa::kMaskWordBits] |= 1ul << (n % numa::kMaskWordBits);
+            break;
+        }
+        const bool has_mask = kind != Kind::kLocal;
+        ::syscall(SYS_mbind, p, size, mode, has_mask ? mask : nullptr,
+                  has_mask ? numa::kMaxNodes + 1 : 0, 0);
+    }
+};
+
+/// @brief Aligned allocator placing large allocations on NUMA nodes
+/// @tparam T An allocated data type
+/// @tparam kAlignment A given alignment
+/// @tparam kMinNumaSize Allocations of at least this size in bytes are mapped and placed
+/// @details Satisfies Allocator requirements. Large allocations are anonymous mappings
+/// bound with mbind(2) according to the NumaPlacement the allocator carries, small ones go
+/// to posix_memalign. The path is selected by the size only, so deallocate() finds it from @p n
+template <typename T, size_t kAlignment = 16, size_t kMinNumaSize = size_t(1) << 16>
+class NumaAllocator
+{
+    static_assert(utils::is_pow_2(kAlignment) && kAlignment <= 4096);
+
+    NumaPlacement placement_;
+
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = NumaAllocator<U, kAlignment, kMinNumaSize>;
+    };
+
+    NumaAllocator() = default;
+    NumaAllocator(NumaPlacement placement) noexcept : placement_{placement} {}
+
+    template <typename U>
+    NumaAllocator(const NumaAllocator<U, kAlignment, kMinNumaSize> &other) noexcept
+        : placement_{other.placement()}
+    {}
+
+    static constexpr size_t alignment() noexcept { return kAlignment; }
+
+    NumaPlacement placement() const noexcept { return placement_; }
+
+    value_type * allocate(size_t n)
+    {
+        size_t size = sizeof(value_type) * n;
+        void *p;
+        if (is_mapped_(size))
+        {
+            size_t mapped = mapped_size_(size);
+            p = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            placement_.apply(p, mapped);
+        }
+        else if (posix_memalign(&p, kAlignment, size))
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<value_type *>(p);
+    }
+
+    /// Mapped allocations are zero filled by the kernel on first touch
+    value_type * allocate_zeroed(size_t n)
+    {
+        auto *p = allocate(n);
+        if (size_t size = sizeof(value_type) * n; !is_mapped_(size))
+            std::memset(p, 0, size);
+        return p;
+    }
+
+    void deallocate(value_type * p, size_t n) noexcept
+    {
+        size_t size = sizeof(value_type) * n;
+        if (is_mapped_(size))
+            ::munmap(p, mapped_size_(size));
+        else
+            free(p);
+    }
+
+    template <typename U>
+    bool operator==(const NumaAllocator<U, kAlignment, kMinNumaSize> &other) const noexcept
+    {
+        return placement_ == other.placement();
+    }
+
+private:
+    static constexpr bool is_mapped_(size_t size) noexcept { return size >= kMinNumaSize; }
+
+    static size_t mapped_size_(size_t size) noexcept
+    {
+        static const size_t kPageSize = ::sysconf(_SC_PAGESIZE);
+        return utils::div_celling(size, kPageSize) * kPageSize;
+    }
+};
+
+/// @brief Read-only object copied onto every NUMA node, readers pick the copy of their node
+/// @tparam T Copy constructible from (const T &, const T::allocator_type &) with
+/// a NumaAllocator based allocator_type
+/// @details On a single node machine there is only the one copy
+template <typename T>
+class NumaReplicated
+{
+    using Allocator = typename T::allocator_type;
+
+    std::vector<std::unique_ptr<const T>> replicas_;   // one per allowed node
+    std::vector<uint16_t>                 node_to_replica_;
+
+public:
+    explicit NumaReplicated(const T &src)
+    {
+        const auto &nodes = numa::nodes();
+        node_to_replica_.assign(nodes.back() + 1, 0);
+        replicas_.reserve(nodes.size());
+        for (auto node : nodes)
+        {
+            node_to_replica_[node] = static_cast<uint16_t>(replicas_.size());
+            replicas_.push_back(std::make_unique<const T>(src, Allocator(NumaPlacement::on_node(node))));
+        }
+    }
+
+    size_t size() const noexcept { return replicas_.size(); }
+
+    const T & on_node(unsigned node) const noexcept
+    {
+        return *replicas_[node < node_to_replica_.size() ? node_to_replica_[node] : 0];
+    }
+
+    /// Copy on the node of the calling thread
+    const T & local() const noexcept { return on_node(numa::current_node()); }
+};
+
+}
+
+#endif // HUMBLE_NUMA_ALLOCATOR_H_
@@ -0,0 +1,153 @@
+#ifndef HUMBLE_STATS_ALLOCATOR_H_
+#define HUMBLE_STATS_ALLOCATOR_H_
+
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+
+#include "humble/posix/aligned_allocator.h"
+#include "humble/utils.hpp"
+
+namespace hmbl::posix
+{
+
+/// @brief Allocation counters shared by all StatsAllocator instances with the same tag
+/// @details Padding is the tail up to the allocator alignment, which the requested size
+/// doesn't use. The padding histogram is logarithmic: bucket i counts paddings of
+/// bit width i, i.e. bucket 0 is no padding and bucket i > 0 is [2^(i-1), 2^i) bytes
+struct AllocationStats
+{
+    static constexpr size_t kPaddingBuckets = 16;
+
+    struct Snapshot
+    {
+        size_t live_bytes;
+        size_t peak_bytes;
+        size_t allocations;
+        size_t deallocations;
+        size_t padding_bytes;
+        size_t padding_hist[kPaddingBuckets];
+    };
+
+    std::atomic<size_t> live_bytes{};
+    std::atomic<size_t> peak_bytes{};
+    std::atomic<size_t> allocations{};
+    std::atomic<size_t> deallocations{};
+    std::atomic<size_t> padding_bytes{};
+    std::atomic<size_t> padding_hist[kPaddingBuckets]{};
+
+    void on_allocate(size_t bytes, size_t padding) noexcept
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        padding_bytes.fetch_add(padding, std::memory_order_relaxed);
+        padding_hist[std::min<size_t>(std::bit_width(padding), kPaddingBuckets - 1)]
+            .fetch_add(1, std::memory_order_relaxed);
+
+        size_t live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        for (size_t peak = peak_bytes.load(std::memory_order_relaxed);
+             live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed);)
+            ;
+    }
+
+    void on_deallocate(size_t bytes) noexcept
+    {
+        deallocations.fetch_add(1, std::memory_order_relaxed);
+        live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const noexcept
+    {
+        Snapshot res{live_bytes.load(std::memory_order_relaxed),
+                     peak_bytes.load(std::memory_order_relaxed),
+                     allocations.load(std::memory_order_relaxed),
+                     deallocations.load(std::memory_order_relaxed),
+                     padding_bytes.load(std::memory_order_relaxed),
+                     {}};
+        for (size_t i = 0; i < kPaddingBuckets; ++i)
+            res.padding_hist[i] = padding_hist[i].load(std::memory_order_relaxed);
+        return res;
+    }
+};
+
+/// Counters of the given tag
+template <typename TTag>
+AllocationStats & allocation_stats() noexcept
+{
+    static AllocationStats stats;
+    return stats;
+}
+
+/// @brief Aligned allocator adaptor counting allocations in allocation_stats<TTag>()
+/// @tparam TAllocator An underlying aligned allocator
+/// @tparam TTag Any type naming the counters, rebinds keep it
+/// @details Satisfies Allocator requirements and forwards allocate_zeroed()
+template <typename TAllocator, typename TTag = void>
+    requires CAlignedAllocator<TAllocator>
+class StatsAllocator
+{
+    TAllocator alloc_;
+
+public:
+    using value_type = typename TAllocator::value_type;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = StatsAllocator<typename TAllocator::template rebind<U>::other, TTag>;
+    };
+
+    StatsAllocator() = default;
+
+    template <typename TOther>
+        requires std::constructible_from<TAllocator, const TOther &>
+    StatsAllocator(const TOther &other) noexcept : alloc_(other) {}
+
+    template <typename TOther>
+    StatsAllocator(const StatsAllocator<TOther, TTag> &other) noexcept : alloc_(other.base()) {}
+
+    static constexpr size_t alignment() noexcept { return TAllocator::alignment(); }
+
+    static AllocationStats & stats() noexcept { return allocation_stats<TTag>(); }
+
+    const TAllocator & base() const noexcept { return alloc_; }
+
+    value_type * allocate(size_t n)
+    {
+        auto *p = alloc_.allocate(n);
+        on_allocate_(n);
+        return p;
+    }
+
+    value_type * allocate_zeroed(size_t n)
+    {
+        auto *p = posix::allocate_zeroed(alloc_, n);
+        on_allocate_(n);
+        return p;
+    }
+
+    void deallocate(value_type * p, size_t n) noexcept
+    {
+        stats().on_deallocate(sizeof(value_type) * n);
+        alloc_.deallocate(p, n);
+    }
+
+    template <typename TOther>
+    bool operator==(const StatsAllocator<TOther, TTag> &other) const noexcept
+    {
+        return alloc_ == other.base();
+    }
+
+private:
+    static void on_allocate_(size_t n) noexcept
+    {
+        size_t bytes = sizeof(value_type) * n;
+        size_t padding = bytes ? utils::align_up<size_t, alignment()>(bytes) - bytes : 0;
+        stats().on_allocate(bytes, padding);
+    }
+};
+
+}
+
+#endif // HUMBLE_STATS_ALLOCATOR_H_
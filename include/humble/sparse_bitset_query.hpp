@@ -0,0 +1,685 @@
+#ifndef LIBHUMBLE_CPP_SPARSE_BITSET_QUERY_H_
+#define LIBHUMBLE_CPP_SPARSE_BITSET_QUERY_H_
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <concepts>
+#include <initializer_list>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sparse_dynamic_bitset.hpp"
+
+namespace hmbl
+{
+
+/// @brief Boolean expression over SparseDynamicBitsets evaluated by a cost based plan
+/// @tparam TBitset A SparseDynamicBitset. Terms may differ in size(), e.g. growing by append(),
+/// the universe of a call is the largest one among the terms of its root, positions past the end
+/// of a shorter term are unset in it
+/// @details Nodes are hash consed: AND and OR operands are flattened, sorted and deduplicated and
+/// double negations dropped, so equal subexpressions are one node and a call evaluates it once.
+/// Every call orders operands and picks kernels by the statistics of the terms it reaches, taken
+/// again when the version() of a term changed: popcount for selectivity, stored words and live
+/// mask packs (the offsets density) for costs. A call reads no term its root doesn't reach.
+/// An AND scans its cheapest positive operand and probes the others, the most rejecting first;
+/// first() over an AND of a few terms may run the fused and_any() instead, count() counts the
+/// scan without materializing it
+template <typename TBitset>
+class SparseBitsetQuery
+{
+public:
+    using NodeId    = uint32_t;
+    using Positions = std::vector<size_t>;
+
+    enum class Op : uint8_t
+    {
+        kTerm,
+        kAnd,
+        kOr,
+        kNot,
+    };
+
+    /// Kernels run since construction
+    struct Stats
+    {
+        size_t fused{};       // and_any() over an AND of terms
+        size_t scans{};       // AND scans of one operand probing the others
+        size_t merges{};      // OR unions
+        size_t complements{}; // NOT scans over the whole universe
+        size_t reused{};      // subexpression results taken from the memo of a call
+    };
+
+    static constexpr size_t kMaxFusedOperands = kMaxAndAnyOperands;
+
+private:
+    // cost unit is a word or a position handled, a probe walks a few masks
+    static constexpr double kProbeCost = 4;
+
+    struct Node
+    {
+        Op                  op;
+        const TBitset      *term{};
+        std::vector<NodeId> operands;
+
+        // term statistics
+        size_t   count{};
+        size_t   words{};
+        size_t   packs{};
+        size_t   live_packs{};
+        uint64_t id{};      // of the term when they were taken
+        uint64_t version{};
+    };
+
+    // state of one call over the DAG of its root
+    struct Context
+    {
+        std::vector<uint32_t>                 uses;  // parents, a node with two is shared
+        std::vector<double>                   est;   // negative until computed
+        std::vector<double>                   cost;
+        std::vector<std::optional<Positions>> memo;
+    };
+
+    struct AndPlan
+    {
+        std::optional<NodeId>                driver;  // nothing scans the whole universe
+        std::vector<std::pair<NodeId, bool>> probes;  // operand, negated
+        double                               cost{};
+        bool                                 fused{};
+    };
+
+    // type erased position consumer, false stops the scan
+    class Sink
+    {
+        void  *func_;
+        bool (*call_)(void *, size_t);
+
+    public:
+        template <typename TFunc>
+            requires (!std::same_as<std::remove_const_t<TFunc>, Sink>)
+        Sink(TFunc &func) noexcept
+            : func_{&func}
+            , call_{[](void *func, size_t pos) { return (*static_cast<TFunc *>(func))(pos); }}
+        {}
+
+        bool operator()(size_t pos) const { return call_(func_, pos); }
+    };
+
+    // membership of non-decreasing positions in an AND operand
+    struct Probe
+    {
+        std::optional<typename TBitset::Cursor> cursor;      // a term
+        const Positions                        *positions{}; // anything else, materialized
+        size_t                                  at{};
+        bool                                    negated{};
+
+        bool test(size_t pos) noexcept
+        {
+            bool in;
+            if (cursor)
+            {
+                in = cursor->test(pos);
+            }
+            else
+            {
+                at = std::lower_bound(std::cbegin(*positions) + at, std::cend(*positions), pos) - std::cbegin(*positions);
+                in = at < positions->size() && (*positions)[at] == pos;
+            }
+            return in != negated;
+        }
+    };
+
+    template <typename TResolve>
+    struct Parser;
+
+    std::vector<Node>                                                       nodes_;
+    std::map<std::tuple<Op, const TBitset *, std::vector<NodeId>>, NodeId> interned_;
+    size_t                                                                  universe_{};
+    Stats                                                                   stats_{};
+
+public:
+    /// Leaf interned by the address of @p bitset, which may change between calls but not during one
+    /// @details The bitset MUST outlive the calls over roots reaching the term. A term of a destroyed
+    /// bitset stays interned and is just never read again, or taken over by a bitset at its address
+    NodeId term(const TBitset &bitset)
+    {
+        if (auto it = interned_.find({Op::kTerm, &bitset, {}}); it != std::end(interned_))
+            return it->second;
+        Node node{Op::kTerm, &bitset, {}};
+        take_stats_(node);
+        return intern_(std::move(node));
+    }
+
+    NodeId and_of(std::span<const NodeId> operands)      { return combine_(Op::kAnd, operands); }
+    NodeId and_of(std::initializer_list<NodeId> operands) { return and_of(std::span(operands.begin(), operands.size())); }
+    NodeId or_of(std::span<const NodeId> operands)       { return combine_(Op::kOr, operands); }
+    NodeId or_of(std::initializer_list<NodeId> operands)  { return or_of(std::span(operands.begin(), operands.size())); }
+
+    NodeId not_of(NodeId operand)
+    {
+        assert(operand < std::size(nodes_));
+        if (nodes_[operand].op == Op::kNot)
+            return nodes_[operand].operands.front();
+        return intern_(Node{Op::kNot, nullptr, {operand}});
+    }
+
+    /// Parse names, ! (not), & (and), | (or) and parentheses, ! binds tighter than & than |
+    /// @param resolve Callable mapping a name to const TBitset *, nullptr if unknown
+    /// @return root node, nothing on a syntax error or an unknown name
+    template <typename TResolve>
+    std::optional<NodeId> parse(std::string_view text, TResolve &&resolve)
+    {
+        Parser<TResolve> parser{*this, text, resolve};
+        auto root = parser.parse_or();
+        parser.skip_spaces();
+        if (parser.pos != std::size(text))
+            return std::nullopt;
+        return root;
+    }
+
+    Op                      op(NodeId id)       const noexcept { return nodes_[id].op; }
+    std::span<const NodeId> operands(NodeId id) const noexcept { return nodes_[id].operands; }
+
+    size_t       size_nodes() const noexcept { return std::size(nodes_); }
+    size_t       universe()   const noexcept { return universe_; } // largest size() of the terms of the last call
+    const Stats &stats()      const noexcept { return stats_; }
+
+    /// Expected number of positions, as if the terms were independent
+    double estimate(NodeId id)
+    {
+        auto ctx = context_(id);
+        return estimate_(id, ctx);
+    }
+
+    /// Lowest position of the expression
+    std::optional<size_t> first(NodeId root)
+    {
+        auto ctx = context_(root);
+        return first_(root, ctx, universe_);
+    }
+
+    size_t count(NodeId root)
+    {
+        auto ctx = context_(root);
+        return count_(root, ctx);
+    }
+
+    /// All positions in increasing order
+    Positions materialize(NodeId root)
+    {
+        auto ctx = context_(root);
+        materialize_(root, ctx);
+        return std::move(*ctx.memo[root]);
+    }
+
+private:
+    NodeId intern_(Node node)
+    {
+        auto [it, inserted] = interned_.try_emplace({node.op, node.term, node.operands}, NodeId(std::size(nodes_)));
+        if (inserted)
+            nodes_.push_back(std::move(node));
+        return it->second;
+    }
+
+    NodeId combine_(Op op, std::span<const NodeId> operands)
+    {
+        assert(!operands.empty());
+        std::vector<NodeId> flat;
+        for (auto id : operands)
+        {
+            assert(id < std::size(nodes_));
+            if (nodes_[id].op == op)
+                flat.insert(std::end(flat), std::cbegin(nodes_[id].operands), std::cend(nodes_[id].operands));
+            else
+                flat.push_back(id);
+        }
+        std::sort(std::begin(flat), std::end(flat));
+        flat.erase(std::unique(std::begin(flat), std::end(flat)), std::end(flat));
+        if (std::size(flat) == 1)
+            return flat.front();
+        return intern_(Node{op, nullptr, std::move(flat)});
+    }
+
+    static void take_stats_(Node &node)
+    {
+        node.count      = node.term->count();
+        node.words      = node.term->size_words();
+        node.packs      = node.term->size_packs();
+        node.live_packs = node.term->count_packs();
+        node.id         = node.term->id();
+        node.version    = node.term->version();
+    }
+
+    // a term changed since the last call, e.g. by append(), is planned by its current statistics
+    void refresh_term_(Node &node)
+    {
+        if (node.id != node.term->id() || node.version != node.term->version())
+            take_stats_(node);
+        universe_ = std::max(universe_, node.term->size());
+    }
+
+    Context context_(NodeId root)
+    {
+        assert(root < std::size(nodes_));
+        const size_t n = std::size(nodes_);
+        Context ctx{std::vector<uint32_t>(n), std::vector<double>(n, -1), std::vector<double>(n, -1),
+                    std::vector<std::optional<Positions>>(n)};
+        universe_ = 0;
+        std::vector<bool>   seen(n);
+        std::vector<NodeId> stack{root};
+        seen[root] = true;
+        while (!stack.empty())
+        {
+            auto id = stack.back();
+            stack.pop_back();
+            if (nodes_[id].op == Op::kTerm)
+                refresh_term_(nodes_[id]);
+            for (auto operand : nodes_[id].operands)
+            {
+                ++ctx.uses[operand];
+                if (!seen[operand])
+                {
+                    seen[operand] = true;
+                    stack.push_back(operand);
+                }
+            }
+        }
+        return ctx;
+    }
+
+    double estimate_(NodeId id, Context &ctx) const
+    {
+        if (ctx.est[id] >= 0)
+            return ctx.est[id];
+        const auto  &node = nodes_[id];
+        const double u    = double(std::max<size_t>(universe_, 1));
+        double       res{};
+        switch (node.op)
+        {
+        case Op::kTerm:
+            res = double(node.count);
+            break;
+        case Op::kNot:
+            res = u - estimate_(node.operands.front(), ctx);
+            break;
+        case Op::kAnd:
+            res = u;
+            for (auto operand : node.operands)
+                res *= estimate_(operand, ctx) / u;
+            break;
+        case Op::kOr:
+            res = 1;
+            for (auto operand : node.operands)
+                res *= 1 - estimate_(operand, ctx) / u;
+            res = (1 - res) * u;
+            break;
+        }
+        return ctx.est[id] = res;
+    }
+
+    // cost of producing the positions of a node in increasing order
+    double scan_cost_(NodeId id, Context &ctx)
+    {
+        if (ctx.memo[id])
+            return double(ctx.memo[id]->size());
+        if (ctx.cost[id] >= 0)
+            return ctx.cost[id];
+        const auto &node = nodes_[id];
+        double      res{};
+        switch (node.op)
+        {
+        case Op::kTerm:
+            res = double(node.live_packs + node.words + node.count); // for_each() walks live packs only
+            break;
+        case Op::kNot:
+            res = double(universe_) * (1 + kProbeCost) + probe_cost_(node.operands.front(), ctx);
+            break;
+        case Op::kAnd:
+            res = plan_and_(id, ctx, false).cost;
+            break;
+        case Op::kOr:
+            for (auto operand : node.operands)
+                res += scan_cost_(operand, ctx) + estimate_(operand, ctx);
+            break;
+        }
+        return ctx.cost[id] = res;
+    }
+
+    // setup cost of a probe, anything but a term is materialized
+    double probe_cost_(NodeId id, Context &ctx)
+    {
+        return nodes_[id].op == Op::kTerm ? 0 : scan_cost_(id, ctx);
+    }
+
+    AndPlan plan_and_(NodeId id, Context &ctx, bool first)
+    {
+        const auto &node = nodes_[id];
+        std::vector<NodeId> positive, negative;
+        double              setup{};
+        for (auto operand : node.operands)
+        {
+            const bool negated = nodes_[operand].op == Op::kNot;
+            const auto target  = negated ? nodes_[operand].operands.front() : operand;
+            (negated ? negative : positive).push_back(target);
+            setup += probe_cost_(target, ctx);
+        }
+        // a probe of a rare operand rejects the most, a negated one the more common it is
+        std::sort(std::begin(positive), std::end(positive),
+                  [&](NodeId a, NodeId b) { return estimate_(a, ctx) < estimate_(b, ctx); });
+        std::sort(std::begin(negative), std::end(negative),
+                  [&](NodeId a, NodeId b) { return estimate_(a, ctx) > estimate_(b, ctx); });
+
+        AndPlan      plan;
+        const double probes = double(std::size(node.operands) - 1);
+        plan.cost = double(universe_) * (1 + (probes + 1) * kProbeCost) + setup;
+        for (auto operand : positive)
+        {
+            const double cost = scan_cost_(operand, ctx) + estimate_(operand, ctx) * probes * kProbeCost
+                              + setup - probe_cost_(operand, ctx);
+            if (cost < plan.cost)
+            {
+                plan.cost   = cost;
+                plan.driver = operand;
+            }
+        }
+
+        // and_any() loads a mask pack of every operand per step
+        if (first && negative.empty() && std::size(positive) <= kMaxFusedOperands &&
+            std::all_of(std::cbegin(positive), std::cend(positive), [&](NodeId n) { return nodes_[n].op == Op::kTerm; }))
+        {
+            plan.fused = double(std::size(positive) * nodes_[positive.front()].packs) <= plan.cost;
+        }
+
+        for (auto operand : positive)
+            if (operand != plan.driver)
+                plan.probes.emplace_back(operand, false);
+        for (auto operand : negative)
+            plan.probes.emplace_back(operand, true);
+        return plan;
+    }
+
+    const Positions & materialize_(NodeId id, Context &ctx)
+    {
+        if (ctx.memo[id])
+        {
+            ++stats_.reused;
+            return *ctx.memo[id];
+        }
+        Positions res;
+        if (nodes_[id].op == Op::kOr)
+        {
+            res = merge_(id, ctx);
+        }
+        else
+        {
+            res.reserve(std::min<size_t>(size_t(estimate_(id, ctx)), universe_));
+            auto push = [&](size_t pos) { res.push_back(pos); return true; };
+            scan_node_(id, ctx, Sink(push));
+        }
+        ctx.memo[id] = std::move(res);
+        return *ctx.memo[id];
+    }
+
+    // union of the operands, the smallest first to copy less
+    Positions merge_(NodeId id, Context &ctx)
+    {
+        ++stats_.merges;
+        std::vector<NodeId> operands(nodes_[id].operands);
+        std::sort(std::begin(operands), std::end(operands),
+                  [&](NodeId a, NodeId b) { return estimate_(a, ctx) < estimate_(b, ctx); });
+        Positions res, tmp;
+        for (auto operand : operands)
+        {
+            const auto &positions = materialize_(operand, ctx);
+            tmp.clear();
+            tmp.reserve(std::size(res) + std::size(positions));
+            std::set_union(std::cbegin(res), std::cend(res), std::cbegin(positions), std::cend(positions),
+                           std::back_inserter(tmp));
+            res.swap(tmp);
+        }
+        return res;
+    }
+
+    // positions in increasing order, a shared subexpression is materialized once
+    bool scan_(NodeId id, Context &ctx, Sink sink)
+    {
+        if (nodes_[id].op != Op::kTerm && (ctx.memo[id] || ctx.uses[id] > 1))
+        {
+            for (auto pos : materialize_(id, ctx))
+                if (!sink(pos))
+                    return false;
+            return true;
+        }
+        return scan_node_(id, ctx, sink);
+    }
+
+    bool scan_node_(NodeId id, Context &ctx, Sink sink)
+    {
+        const auto &node = nodes_[id];
+        switch (node.op)
+        {
+        case Op::kTerm:
+            return node.term->for_each(sink);
+        case Op::kNot:
+        {
+            ++stats_.complements;
+            const std::pair<NodeId, bool> probe{node.operands.front(), true};
+            return scan_filtered_(std::nullopt, std::span(&probe, 1), ctx, sink);
+        }
+        case Op::kAnd:
+        {
+            ++stats_.scans;
+            const auto plan = plan_and_(id, ctx, false);
+            return scan_filtered_(plan.driver, plan.probes, ctx, sink);
+        }
+        case Op::kOr:
+            break;
+        }
+        for (auto pos : materialize_(id, ctx))
+            if (!sink(pos))
+                return false;
+        return true;
+    }
+
+    bool scan_filtered_(std::optional<NodeId> driver, std::span<const std::pair<NodeId, bool>> targets,
+                        Context &ctx, Sink sink)
+    {
+        std::vector<Probe> probes(std::size(targets));
+        for (size_t i = 0; i < std::size(targets); ++i)
+        {
+            const auto &node = nodes_[targets[i].first];
+            if (node.op == Op::kTerm)
+                probes[i].cursor.emplace(node.term->cursor());
+            else
+                probes[i].positions = &materialize_(targets[i].first, ctx);
+            probes[i].negated = targets[i].second;
+        }
+
+        auto filter = [&](size_t pos)
+        {
+            for (auto &probe : probes)
+                if (!probe.test(pos))
+                    return true;
+            return sink(pos);
+        };
+        if (driver)
+            return scan_(*driver, ctx, Sink(filter));
+        for (size_t pos = 0; pos < universe_; ++pos)
+            if (!filter(pos))
+                return false;
+        return true;
+    }
+
+    std::optional<size_t> first_(NodeId id, Context &ctx, size_t limit)
+    {
+        const auto &node = nodes_[id];
+        if (!ctx.memo[id] && ctx.uses[id] <= 1)
+        {
+            if (node.op == Op::kOr)
+            {
+                // the cheapest operands first, later ones only look below the best found
+                std::vector<NodeId> operands(node.operands);
+                std::sort(std::begin(operands), std::end(operands),
+                          [&](NodeId a, NodeId b) { return scan_cost_(a, ctx) < scan_cost_(b, ctx); });
+                std::optional<size_t> best;
+                for (auto operand : operands)
+                    if (auto pos = first_(operand, ctx, best.value_or(limit)))
+                        best = pos;
+                return best;
+            }
+            if (node.op == Op::kAnd)
+            {
+                if (auto plan = plan_and_(id, ctx, true); plan.fused)
+                {
+                    ++stats_.fused;
+                    // the rarest first, its empty masks end the pack checks early
+                    std::vector<NodeId> operands(node.operands);
+                    std::sort(std::begin(operands), std::end(operands),
+                              [&](NodeId a, NodeId b) { return nodes_[a].count < nodes_[b].count; });
+                    std::vector<const TBitset *> terms;
+                    for (auto operand : operands)
+                        terms.push_back(nodes_[operand].term);
+                    auto pos = and_any_dynamic<TBitset>(terms);
+                    return pos && *pos < limit ? pos : std::nullopt;
+                }
+            }
+        }
+
+        std::optional<size_t> res;
+        auto stop = [&](size_t pos)
+        {
+            if (pos < limit)
+                res = pos;
+            return false;
+        };
+        scan_(id, ctx, Sink(stop));
+        return res;
+    }
+
+    size_t count_(NodeId id, Context &ctx)
+    {
+        if (ctx.memo[id])
+        {
+            ++stats_.reused;
+            return ctx.memo[id]->size();
+        }
+        const auto &node = nodes_[id];
+        switch (node.op)
+        {
+        case Op::kTerm:
+            return node.count;
+        case Op::kNot:
+            return universe_ - count_(node.operands.front(), ctx);
+        case Op::kOr:
+            return materialize_(id, ctx).size();
+        case Op::kAnd:
+            break;
+        }
+        size_t res{};
+        auto inc = [&](size_t) { ++res; return true; };
+        scan_(id, ctx, Sink(inc));
+        return res;
+    }
+};
+
+template <typename TBitset>
+template <typename TResolve>
+struct SparseBitsetQuery<TBitset>::Parser
+{
+    SparseBitsetQuery &query;
+    std::string_view   text;
+    TResolve          &resolve;
+    size_t             pos{};
+
+    static bool is_name_char(char c) noexcept
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               c == '_' || c == '.' || c == ':' || c == '-';
+    }
+
+    void skip_spaces() noexcept
+    {
+        while (pos < std::size(text) && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n'))
+            ++pos;
+    }
+
+    bool accept(char c) noexcept
+    {
+        skip_spaces();
+        if (pos < std::size(text) && text[pos] == c)
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    // or := and ('|' and)*
+    std::optional<NodeId> parse_or()
+    {
+        std::vector<NodeId> operands;
+        do
+        {
+            auto operand = parse_and();
+            if (!operand)
+                return std::nullopt;
+            operands.push_back(*operand);
+        } while (accept('|'));
+        return query.or_of(operands);
+    }
+
+    // and := unary ('&' unary)*
+    std::optional<NodeId> parse_and()
+    {
+        std::vector<NodeId> operands;
+        do
+        {
+            auto operand = parse_unary();
+            if (!operand)
+                return std::nullopt;
+            operands.push_back(*operand);
+        } while (accept('&'));
+        return query.and_of(operands);
+    }
+
+    // unary := '!' unary | '(' or ')' | name
+    std::optional<NodeId> parse_unary()
+    {
+        if (accept('!'))
+        {
+            auto operand = parse_unary();
+            if (!operand)
+                return std::nullopt;
+            return query.not_of(*operand);
+        }
+        if (accept('('))
+        {
+            auto operand = parse_or();
+            if (!operand || !accept(')'))
+                return std::nullopt;
+            return operand;
+        }
+        skip_spaces();
+        const size_t begin = pos;
+        while (pos < std::size(text) && is_name_char(text[pos]))
+            ++pos;
+        if (pos == begin)
+            return std::nullopt;
+        const TBitset *bitset = resolve(text.substr(begin, pos - begin));
+        if (!bitset)
+            return std::nullopt;
+        return query.term(*bitset);
+    }
+};
+
+}
+
+#endif // LIBHUMBLE_CPP_SPARSE_BITSET_QUERY_H_
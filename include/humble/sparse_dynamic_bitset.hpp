@@ -4,11 +4,14 @@
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
 #include <concepts>
 #include <bit>
 #include <memory>
 #include <optional>
 #include <span>
+#include <utility>
 #include <vector>
 
 #include <immintrin.h>
@@ -17,12 +20,6 @@
 #include "constants.hpp"
 #include "utils.hpp"
 
-#ifdef __clang__
-    #define ALWAYS_UNROLL _Pragma("clang loop unroll(full)")
-#elif defined(__GNUC__)
-    #define ALWAYS_UNROLL _Pragma("GCC unroll 65534")
-#endif
-
 namespace hmbl
 {
 
@@ -32,8 +29,15 @@ struct SparseDynamicBitsetBase
     using Word         = TWord;
     using CompressMask = TCompressMask; // one bit masks one word
 
-    using CompressMaskAlloc = typename TAllocator::template rebind<CompressMask>::other;
-    using WordsAlloc        = typename TAllocator::template rebind<Word>::other;
+    using WordOffset = unsigned;
+
+    // storage starts zeroed straight from the allocator, the holders never shrink it
+    template <typename T>
+    using ZeroedAlloc = posix::detail::ZeroInitAllocator<typename TAllocator::template rebind<T>::other>;
+
+    using CompressMaskAlloc = ZeroedAlloc<CompressMask>;
+    using WordsAlloc        = ZeroedAlloc<Word>;
+    using WordOffsetsAlloc  = ZeroedAlloc<WordOffset>;
 
     static constexpr size_t kVectorByteSize = kVectorByteSize_;
     static constexpr size_t kVectorBitSize  = kVectorByteSize * K::kBitsPerByte;
@@ -46,11 +50,30 @@ struct SparseDynamicBitsetBase
     static constexpr size_t kCompressMaskBitSize      = kCompressMaskByteSize * K::kBitsPerByte;
     static constexpr size_t kCompressMaskPackByteSize = kVectorByteSize / kCompressMaskByteSize;
 
+    // words are read by 64 bit limbs, a narrower word is a single limb
+    static constexpr size_t kLimbBitSize = std::min<size_t>(kWordBitSize, 64);
+    static constexpr size_t kLimbs       = kWordBitSize / kLimbBitSize;
+
+    static uint64_t limb_(const Word &word, size_t i) noexcept
+    {
+        if constexpr (std::unsigned_integral<Word>)
+            return (void)i, word;
+        else
+            return word.val64[i];
+    }
+
+    static void set_limb_bit_(Word &word, size_t shift) noexcept
+    {
+        if constexpr (std::unsigned_integral<Word>)
+            word |= Word(1) << shift;
+        else
+            word.val64[shift / kLimbBitSize] |= uint64_t(1) << (shift % kLimbBitSize);
+    }
+
     struct CompressMaskHolder
     {
-        using WordOffset = unsigned;
         std::vector<CompressMask, CompressMaskAlloc> mem;
-        std::vector<WordOffset>                      offsets; // compressed words per mask pack to improve skipping
+        std::vector<WordOffset, WordOffsetsAlloc>    offsets; // compressed words per mask pack to improve skipping
 
         // takes original pos
         void set_bit(size_t pos, bool v) noexcept
@@ -64,16 +87,16 @@ struct SparseDynamicBitsetBase
         }
 
         template <typename TPoses>
-        CompressMaskHolder(TPoses &poses, size_t bit_size)
+        CompressMaskHolder(TPoses &poses, size_t bit_size, const TAllocator &alloc)
+            : mem(CompressMaskAlloc(alloc))
+            , offsets(WordOffsetsAlloc(alloc))
         {
-            size_t size     = utils::div_celling(bit_size, kVectorBitSize);
-            size_t mem_size = utils::align_up<size_t, kVectorByteSize>(size);
+            size_t size     = bit_size ? utils::div_celling(bit_size, kVectorBitSize) : 0;
+            size_t mem_size = size ? utils::align_up<size_t, kVectorByteSize>(size) : 0; // empty to append() to
             mem.reserve(mem_size);
             mem.resize(size);
             assert(!(mem_size % kCompressMaskPackByteSize));
             offsets.resize(mem_size / kCompressMaskPackByteSize);
-            std::memset(std::data(mem), 0, kCompressMaskByteSize * mem_size);
-            std::memset(std::data(offsets), 0, sizeof(WordOffset) * std::size(offsets));
 
             for (auto pos : poses)
                 set_bit(pos, true);
@@ -87,6 +110,27 @@ struct SparseDynamicBitsetBase
             }
         }
 
+        // keeps the zeroed padding up to the vector size
+        CompressMaskHolder(const CompressMaskHolder &other, const TAllocator &alloc)
+            : mem(CompressMaskAlloc(alloc))
+            , offsets(other.offsets, WordOffsetsAlloc(alloc))
+        {
+            mem.reserve(other.mem.capacity());
+            mem.assign(std::cbegin(other.mem), std::cend(other.mem));
+        }
+
+        // whole vectors of masks at least doubled, the tail past size() stays zeroed for pack loads
+        void grow(size_t size)
+        {
+            if (size > mem.capacity())
+            {
+                mem.reserve(utils::align_up<size_t, kVectorByteSize>(std::max(size, 2 * mem.capacity())));
+                offsets.reserve(mem.capacity() / kCompressMaskPackByteSize);
+            }
+            mem.resize(size);
+            offsets.resize(utils::align_up<size_t, kVectorByteSize>(size) / kCompressMaskPackByteSize);
+        }
+
         auto popcount() noexcept
         {
             size_t res{};
@@ -107,12 +151,28 @@ struct SparseDynamicBitsetBase
         std::vector<Word, WordsAlloc> mem;
 
         template <typename TPoses>
-        WordsHolder(TPoses &poses, size_t size)
+        WordsHolder(TPoses &poses, size_t size, const TAllocator &alloc)
+            : mem(WordsAlloc(alloc))
         {
-            size_t mem_size = utils::align_up<size_t, kVectorByteSize>(size);
+            size_t mem_size = size ? utils::align_up<size_t, kVectorByteSize>(size) : 0; // no bits set
             mem.reserve(mem_size);
             mem.resize(size);
-            std::memset(std::data(mem), 0, kWordByteSize * mem_size);
+        }
+
+        WordsHolder(const WordsHolder &other, const TAllocator &alloc)
+            : mem(WordsAlloc(alloc))
+        {
+            mem.reserve(other.mem.capacity());
+            mem.assign(std::cbegin(other.mem), std::cend(other.mem));
+        }
+
+        // appends a zeroed word, whole vectors of words at least doubled
+        Word & grow()
+        {
+            if (mem.size() == mem.capacity())
+                mem.reserve(utils::align_up<size_t, kVectorByteSize>(std::max<size_t>(1, 2 * mem.capacity())));
+            mem.resize(mem.size() + 1);
+            return mem.back();
         }
 
         auto size() const noexcept { return std::size(mem); }
@@ -122,18 +182,201 @@ struct SparseDynamicBitsetBase
     };
 
     size_t             bit_size_{};
+    size_t             set_end_{};      // one past the last set position, append() goes on from it
     CompressMaskHolder mask_;
     WordsHolder        words_;
+    uint64_t           id_{next_id_()}; // a copy is another bitset
+    uint64_t           version_{};      // bumped by every change
+
+    static uint64_t next_id_() noexcept
+    {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
 
 public:
     // init_pos should be sorted
     template <typename TPoses>
-    SparseDynamicBitsetBase(const TPoses &poses, size_t bit_size)
+    SparseDynamicBitsetBase(const TPoses &poses, size_t bit_size, const TAllocator &alloc = TAllocator())
         : bit_size_{bit_size}
-        , mask_(poses, bit_size)
-        , words_(poses, mask_.popcount())
+        , set_end_{std::empty(poses) ? 0 : *std::prev(std::cend(poses)) + 1}
+        , mask_(poses, bit_size, alloc)
+        , words_(poses, mask_.popcount(), alloc)
+    {
+    }
+
+    SparseDynamicBitsetBase(const SparseDynamicBitsetBase &other, const TAllocator &alloc)
+        : bit_size_{other.bit_size_}
+        , set_end_{other.set_end_}
+        , mask_(other.mask_, alloc)
+        , words_(other.words_, alloc)
+    {
+    }
+
+    SparseDynamicBitsetBase(const SparseDynamicBitsetBase &other)
+        : SparseDynamicBitsetBase(other, other.get_allocator())
+    {
+    }
+
+    // the moved from bitset changes its contents, so it takes a new identity
+    SparseDynamicBitsetBase(SparseDynamicBitsetBase &&other) noexcept
+        : bit_size_{std::exchange(other.bit_size_, 0)}
+        , set_end_{std::exchange(other.set_end_, 0)}
+        , mask_(std::move(other.mask_))
+        , words_(std::move(other.words_))
+        , id_{std::exchange(other.id_, next_id_())}
+        , version_{other.version_}
+    {
+    }
+
+    SparseDynamicBitsetBase & operator=(SparseDynamicBitsetBase &&other) noexcept
+    {
+        bit_size_ = std::exchange(other.bit_size_, 0);
+        set_end_  = std::exchange(other.set_end_, 0);
+        mask_     = std::move(other.mask_);
+        words_    = std::move(other.words_);
+        id_       = std::exchange(other.id_, next_id_());
+        version_  = other.version_;
+        return *this;
+    }
+
+    TAllocator get_allocator() const noexcept { return TAllocator(words_.mem.get_allocator()); }
+
+    /// Bytes of storage held, padding included, the object itself excluded
+    size_t memory_usage() const noexcept
+    {
+        return mask_.mem.capacity()     * sizeof(CompressMask)
+             + mask_.offsets.capacity() * sizeof(WordOffset)
+             + words_.mem.capacity()    * sizeof(Word);
+    }
+
+    /// Number of bits, positions are [0, size())
+    size_t size() const noexcept { return bit_size_; }
+
+    /// Identity and change count, together they name the contents, e.g. for cached results
+    uint64_t id()      const noexcept { return id_; }
+    uint64_t version() const noexcept { return version_; }
+
+    /// Number of bits set
+    size_t count() const noexcept
+    {
+        size_t res{};
+        for (const auto &word : words_.mem)
+            ALWAYS_UNROLL for (size_t i = 0; i < kLimbs; ++i)
+                res += std::popcount(limb_(word, i));
+        return res;
+    }
+
+    /// Stored words, only the ones with a bit set are kept
+    size_t size_words() const noexcept { return words_.size(); }
+
+    /// Mask packs, the unit and_any() skips by
+    size_t size_packs() const noexcept { return mask_.size_packs(); }
+
+    /// Mask packs holding at least one word, the rest is skipped by and_any() and for_each()
+    size_t count_packs() const noexcept
     {
+        return std::count_if(std::cbegin(mask_.offsets), std::cend(mask_.offsets), [](auto n) { return n != 0; });
+    }
+
+    bool test(size_t pos) const noexcept { return cursor().test(pos); }
+
+    /// @brief Set @p pos in amortized O(1), past size() the bitset grows to pos + 1
+    /// @details Positions MUST not decrease. The bitset stays an and_any() operand between
+    /// appends, and_any() of bitsets of different sizes ends with the shortest one
+    void append(size_t pos)
+    {
+        assert(pos + 1 >= set_end_); // positions MUST not decrease, the words are kept in order
+        set_end_ = pos + 1;
+        const size_t mask_i = pos / kVectorBitSize;
+        const size_t bit_i  = pos % kVectorBitSize / kWordBitSize;
+        if (mask_i >= mask_.size())
+            mask_.grow(mask_i + 1);
+        bit_size_ = std::max(bit_size_, pos + 1);
+
+        auto &mask = mask_.data()[mask_i];
+        if ((mask >> bit_i) & 1)
+        {
+            set_limb_bit_(words_.mem.back(), pos % kWordBitSize); // the word of the last position
+        }
+        else
+        {
+            mask |= CompressMask(1) << bit_i;
+            ++mask_.offsets[mask_i / kCompressMaskPackByteSize];
+            set_limb_bit_(words_.grow(), pos % kWordBitSize);
+        }
+        ++version_;
     }
+
+    /// Visit set positions in increasing order until @p func returns false
+    /// @return false if stopped by @p func
+    template <typename TFunc>
+    bool for_each(TFunc &&func) const
+    {
+        const Word *word = words_.data();
+        for (size_t pack_i = 0; pack_i < mask_.size_packs(); ++pack_i)
+        {
+            if (!mask_.offsets[pack_i])
+                continue;
+            const size_t mask_end = std::min((pack_i + 1) * kCompressMaskPackByteSize, mask_.size());
+            for (size_t mask_i = pack_i * kCompressMaskPackByteSize; mask_i < mask_end; ++mask_i)
+            {
+                for (auto mask = mask_.data()[mask_i]; mask; mask = CompressMask(mask & (mask - 1)), ++word)
+                {
+                    const size_t base = mask_i * kVectorBitSize + std::countr_zero(mask) * kWordBitSize;
+                    ALWAYS_UNROLL for (size_t i = 0; i < kLimbs; ++i)
+                        for (auto limb = limb_(*word, i); limb; limb &= limb - 1)
+                            if (!func(base + i * kLimbBitSize + std::countr_zero(limb)))
+                                return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /// @brief Membership test of non-decreasing positions, words are located by a walk
+    /// over the pack offsets, so a scan of probes costs one pass over the masks
+    class Cursor
+    {
+        const SparseDynamicBitsetBase *bitset_;
+        size_t                         mask_i_{};    // mask of the last probe
+        size_t                         mask_word_{}; // index of the first word of mask_i_
+
+    public:
+        explicit Cursor(const SparseDynamicBitsetBase &bitset) noexcept : bitset_{&bitset} {}
+
+        bool test(size_t pos) noexcept
+        {
+            if (pos >= bitset_->bit_size_)
+                return false; // past the end of a shorter bitset
+            const auto  &mask   = bitset_->mask_;
+            const size_t mask_i = pos / kVectorBitSize;
+            assert(mask_i >= mask_i_); // positions MUST not decrease
+
+            // whole packs by the offsets, then mask by mask
+            size_t pack_i = mask_i_ / kCompressMaskPackByteSize;
+            if (const size_t target_pack = mask_i / kCompressMaskPackByteSize; target_pack > pack_i)
+            {
+                for (size_t mi = mask_i_; mi < (pack_i + 1) * kCompressMaskPackByteSize; ++mi)
+                    mask_word_ += std::popcount(mask.data()[mi]);
+                for (++pack_i; pack_i < target_pack; ++pack_i)
+                    mask_word_ += mask.offsets[pack_i];
+                mask_i_ = target_pack * kCompressMaskPackByteSize;
+            }
+            for (; mask_i_ < mask_i; ++mask_i_)
+                mask_word_ += std::popcount(mask.data()[mask_i_]);
+
+            const size_t       bit_i = pos % kVectorBitSize / kWordBitSize;
+            const CompressMask m     = mask.data()[mask_i];
+            if (!((m >> bit_i) & 1))
+                return false;
+            const size_t word_i = mask_word_ + std::popcount(CompressMask(m & ((CompressMask(1) << bit_i) - 1)));
+            const size_t shift  = pos % kWordBitSize;
+            return (limb_(bitset_->words_.data()[word_i], shift / kLimbBitSize) >> (shift % kLimbBitSize)) & 1;
+        }
+    };
+
+    Cursor cursor() const noexcept { return Cursor(*this); }
 };
 
 #if defined(__AVX512F__) && defined(__AVX512VL__)
@@ -182,9 +425,17 @@ class SparseDynamicBitset : private SparseDynamicBitsetBase<64, uint32_t, __mmas
     using Base::SparseDynamicBitsetBase;
 
 public:
+    using allocator_type = TAllocator;
+
+    /// Empty bitset to append() to
+    explicit SparseDynamicBitset(const TAllocator &alloc = TAllocator())
+        : Base::SparseDynamicBitsetBase(std::span<const size_t>{}, 0, alloc)
+    {
+    }
+
     template <typename TPoses>
-    SparseDynamicBitset(const TPoses &poses, size_t bit_size)
-        : Base::SparseDynamicBitsetBase(poses, bit_size)
+    SparseDynamicBitset(const TPoses &poses, size_t bit_size, const TAllocator &alloc = TAllocator())
+        : Base::SparseDynamicBitsetBase(poses, bit_size, alloc)
     {
         if (std::empty(poses)) [[unlikely]]
             return;
@@ -200,6 +451,27 @@ public:
         }
     }
 
+    /// Copy with storage from @p alloc, e.g. onto another NUMA node
+    SparseDynamicBitset(const SparseDynamicBitset &other, const TAllocator &alloc)
+        : Base::SparseDynamicBitsetBase(other, alloc)
+    {
+    }
+
+    using Base::get_allocator;
+    using Base::memory_usage;
+    using Base::size;
+    using Base::id;
+    using Base::version;
+    using Base::count;
+    using Base::size_words;
+    using Base::size_packs;
+    using Base::count_packs;
+    using Base::test;
+    using Base::append;
+    using Base::for_each;
+    using typename Base::Cursor;
+    using Base::cursor;
+
     // static extent only to unroll internal cycles
     template <typename TBitsets>
     static std::optional<size_t> and_any(TBitsets &&operands) noexcept
@@ -225,7 +497,9 @@ std::optional<size_t> SparseDynamicBitset<TAlloc>::and_any_(std::span<TBitset*,
     ALWAYS_UNROLL for (size_t op_i = 0; op_i < kNOperands; ++op_i)
         op_words[op_i] = operands[op_i]->words_.data();
 
-    auto msize = operands[0]->mask_.size(); // MUST be equal for all operands
+    auto msize = operands[0]->mask_.size(); // masks past the shortest operand can't intersect
+    ALWAYS_UNROLL for (size_t op_i = 1; op_i < kNOperands; ++op_i)
+        msize = std::min(msize, operands[op_i]->mask_.size());
     for (size_t mask_i = 0; mask_i < msize; ) // loop by mask packs
     {
         // check if at least one mask has bits set
@@ -233,7 +507,7 @@ std::optional<size_t> SparseDynamicBitset<TAlloc>::and_any_(std::span<TBitset*,
         ALWAYS_UNROLL for (size_t op_i = 0; op_i < kNOperands; ++op_i)
         {
             const auto &op = *operands[op_i];
-            assert(op.mask_.size() == msize);
+            assert(op.mask_.size() >= msize);
             const CompressMask *mask_p = &(op.mask_.data()[mask_i]);
             assert(!(std::intptr_t(mask_p) % kVectorByteSize));
             __m512i op_packed_mask = _mm512_load_epi64(mask_p); // load mask pack
@@ -251,7 +525,7 @@ std::optional<size_t> SparseDynamicBitset<TAlloc>::and_any_(std::span<TBitset*,
         }
 
         // if at least one non-zero mask found check bytes
-        for (; mask_i < mask_i + kCompressMaskPackByteSize && mask_i < msize; ++mask_i)
+        for (const size_t pack_end = std::min(mask_i + kCompressMaskPackByteSize, msize); mask_i < pack_end; ++mask_i)
         {
             detail::Word512 packed_data;
 
@@ -341,16 +615,26 @@ class SparseDynamicBitset : private SparseDynamicBitsetBase<16, detail::Word128,
 
     static constexpr size_t kHalfWordBitSize = kWordBitSize / 2;
 
+    using Base::kLimbBitSize;
+
     using Base::bit_size_;
     using Base::mask_;
     using Base::words_;
 
 public:
+    using allocator_type = TAllocator;
+
     using Base::SparseDynamicBitsetBase;
 
+    /// Empty bitset to append() to
+    explicit SparseDynamicBitset(const TAllocator &alloc = TAllocator())
+        : Base::SparseDynamicBitsetBase(std::span<const size_t>{}, 0, alloc)
+    {
+    }
+
     template <typename TPoses>
-    SparseDynamicBitset(const TPoses &poses, size_t bit_size)
-        : Base::SparseDynamicBitsetBase(poses, bit_size)
+    SparseDynamicBitset(const TPoses &poses, size_t bit_size, const TAllocator &alloc = TAllocator())
+        : Base::SparseDynamicBitsetBase(poses, bit_size, alloc)
     {
         if (std::empty(poses)) [[unlikely]]
             return;
@@ -372,6 +656,27 @@ public:
         }
     }
 
+    /// Copy with storage from @p alloc, e.g. onto another NUMA node
+    SparseDynamicBitset(const SparseDynamicBitset &other, const TAllocator &alloc)
+        : Base::SparseDynamicBitsetBase(other, alloc)
+    {
+    }
+
+    using Base::get_allocator;
+    using Base::memory_usage;
+    using Base::size;
+    using Base::id;
+    using Base::version;
+    using Base::count;
+    using Base::size_words;
+    using Base::size_packs;
+    using Base::count_packs;
+    using Base::test;
+    using Base::append;
+    using Base::for_each;
+    using typename Base::Cursor;
+    using Base::cursor;
+
     // static extent only to unroll internal cycles
     template <typename TBitsets>
     static std::optional<size_t> and_any(TBitsets &&operands) noexcept
@@ -396,8 +701,7 @@ private:
 #ifdef __SSE4_1__
         vec = _mm_cmpeq_epi64(vec, vec);
 #else
-        static const __m128i kOnesVec = _mm_set1_epi8(0xFF);
-        vec = _mm_move_epi64(kOnesVec);
+        vec = _mm_set1_epi32(-1); // _mm_move_epi64 would zero the high half
 #endif
     }
 
@@ -418,7 +722,9 @@ std::optional<size_t> SparseDynamicBitset<TAlloc>::and_any_(std::span<TBitset*,
     ALWAYS_UNROLL for (size_t op_i = 0; op_i < kNOperands; ++op_i)
         op_words[op_i] = operands[op_i]->words_.data();
 
-    auto msize = operands[0]->mask_.size(); // MUST be equal for all operands
+    auto msize = operands[0]->mask_.size(); // masks past the shortest operand can't intersect
+    ALWAYS_UNROLL for (size_t op_i = 1; op_i < kNOperands; ++op_i)
+        msize = std::min(msize, operands[op_i]->mask_.size());
     for (size_t mask_i = 0; mask_i < msize; )
     {
         // check if at least one mask has bits set
@@ -426,7 +732,7 @@ std::optional<size_t> SparseDynamicBitset<TAlloc>::and_any_(std::span<TBitset*,
         ALWAYS_UNROLL for (size_t op_i = 0; op_i < kNOperands; ++op_i)
         {
             const auto &op = *operands[op_i];
-            assert(op.mask_.size() == msize);
+            assert(op.mask_.size() >= msize);
             const CompressMask *mask_p = &(op.mask_.data()[mask_i]);
             assert(!(std::intptr_t(mask_p) % kVectorByteSize));
             __m128i op_packed_mask = _mm_load_si128(reinterpret_cast<const __m128i*>(mask_p));
@@ -439,7 +745,7 @@ std::optional<size_t> SparseDynamicBitset<TAlloc>::and_any_(std::span<TBitset*,
         }
 
         // if at least one non-zero mask found check bytes
-        for (; mask_i < mask_i + kCompressMaskPackByteSize && mask_i < msize; ++mask_i)
+        for (const size_t pack_end = std::min(mask_i + kCompressMaskPackByteSize, msize); mask_i < pack_end; ++mask_i)
         {
             detail::Word128 packed_data;
             set_all_ones_vec(packed_data.vec);
@@ -479,8 +785,8 @@ std::optional<size_t> SparseDynamicBitset<TAlloc>::and_any_(std::span<TBitset*,
                     if (packed_data.val64[word_i])
                     {
                         return {  mask_i * kVectorBitSize
-                                + word_i * kWordBitSize
-                                + std::countr_zero(packed_data.val64[word_i])}; // TODO
+                                + word_i * kLimbBitSize
+                                + std::countr_zero(packed_data.val64[word_i])};
                     }
                 }
                 assert(0 && "MUST not happen");
@@ -494,6 +800,28 @@ std::optional<size_t> SparseDynamicBitset<TAlloc>::and_any_(std::span<TBitset*,
 #error "Architecture isn't supported"
 #endif // end arch
 
+/// Operands and_any() is unrolled for when the count is known at run time only
+inline constexpr size_t kMaxAndAnyOperands = 8;
+
+/// SparseDynamicBitset::and_any() over 1..kMaxAndAnyOperands operands counted at run time
+template <typename TBitset, size_t kNOperands = 1>
+std::optional<size_t> and_any_dynamic(std::span<const TBitset *const> operands) noexcept
+{
+    if constexpr (kNOperands > kMaxAndAnyOperands)
+    {
+        assert(0 && "too many operands");
+        return std::nullopt;
+    }
+    else
+    {
+        if (std::size(operands) != kNOperands)
+            return and_any_dynamic<TBitset, kNOperands + 1>(operands);
+        const TBitset *fixed[kNOperands];
+        std::copy(std::cbegin(operands), std::cend(operands), fixed);
+        return TBitset::and_any(fixed);
+    }
+}
+
 }
 
 
@@ -6,6 +6,12 @@
 #include <concepts>
 #include <bit>
 
+#ifdef __clang__
+    #define ALWAYS_UNROLL _Pragma("clang loop unroll(full)")
+#elif defined(__GNUC__)
+    #define ALWAYS_UNROLL _Pragma("GCC unroll 65534")
+#endif
+
 namespace hmbl::utils
 {
 
@@ -3,283 +3,2804 @@
 #include <cerrno>
 #include <cstdlib>
 #include <cstdint>
+#include <climits>
+#include <cstring>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
 #include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
 #include <span>
+#include <functional>
 #include <future>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
+#include <immintrin.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
 
+#include "humble/posix/aligned_allocator.h"
+
 namespace hmbl::async
 {
 
-// forwards
-class EPollFdHandle;
-class EPoller;
+// forwards
+class EPollFdHandle;
+class EPoller;
+
+/// Timeout argument value disabling the timeout
+inline constexpr std::chrono::milliseconds kNoTimeout{-1};
+
+namespace detail
+{
+
+/// @brief Edge triggered registration of a handle fd, made lazily by the first wait
+/// @details Watched events only grow, an edge of a direction nobody waits for is just ignored
+class EPollEvent
+{
+    EPoller       *poller_{};
+    EPollFdHandle *fd_handle_{};
+    uint32_t       events_{};        // registered along with the first armed direction
+    uint32_t       enabled_types_{}; // 0 until registered
+
+public:
+    EPollEvent() = default;
+    EPollEvent(EPoller &poller, EPollFdHandle &fd_hdl, uint32_t events);
+    ~EPollEvent();
+
+    auto poller()         const { return poller_; }
+    auto watched()        const { return enabled_types_; }
+
+    /// Watch @p events too, a syscall only if some of them are new
+    void arm(uint32_t events)
+    {
+        events |= EPOLLET | EPOLLRDHUP;
+        if ((enabled_types_ & events) != events)
+            modify(enabled_types_ | events_ | events);
+    }
+
+    void modify(uint32_t events);
+};
+
+/// Pending I/O of a suspended coroutine, redone by the handle on every readiness event
+struct EPollOperation
+{
+    bool (*try_complete)(EPollOperation &op); // true if the coroutine may be resumed
+    bool suspended{};                         // in a waiter slot, released if destroyed so
+};
+
+/// Coroutine suspended on one direction of a handle
+struct EPollWaiter
+{
+    std::coroutine_handle<> coro_handle_;
+    EPollOperation         *op_{}; // I/O to finish before resuming, if any
+};
+
+struct TimerLink
+{
+    TimerLink *prev_{};
+    TimerLink *next_{};
+
+    bool is_linked() const noexcept { return prev_; }
+
+    void unlink() noexcept
+    {
+        prev_->next_ = next_;
+        if (next_) next_->prev_ = prev_;
+        prev_ = next_ = nullptr;
+    }
+
+    void push_front(TimerLink &link) noexcept
+    {
+        link.prev_ = this;
+        link.next_ = next_;
+        if (next_) next_->prev_ = &link;
+        next_ = &link;
+    }
+};
+
+/// Timer of a TimerWheel, resumes the waiting coroutine on expiry
+struct EPollTimer : TimerLink
+{
+    uint64_t                deadline_{}; // in ticks of the wheel
+    std::coroutine_handle<> coro_handle_;
+    bool                    expired_{};
+
+    EPollTimer() = default;
+    ~EPollTimer() { if (is_linked()) unlink(); }
+
+    EPollTimer(const EPollTimer & )             = delete;
+    EPollTimer & operator=(const EPollTimer & ) = delete;
+};
+
+/// @brief Hierarchical timing wheel with 1 ms ticks
+/// @details kLevels levels of 64 slots, a slot of level L spans 64^L ticks. A timer goes to
+/// the level of the highest 6 bit group its deadline differs from the current tick in and is
+/// moved one level down when the wheel reaches its slot. Add and cancel are O(1), every timer
+/// is cascaded at most kLevels - 1 times. Non-empty slots are tracked by bitmaps, so the next
+/// deadline is found without scanning and idle ticks are skipped
+class TimerWheel
+{
+    static constexpr size_t   kLevels   = 4;
+    static constexpr size_t   kSlotBits = 6;
+    static constexpr size_t   kSlots    = size_t(1) << kSlotBits;
+    static constexpr uint64_t kMaxSpan  = uint64_t(1) << (kLevels * kSlotBits); // ~4.6 hours
+
+public:
+    static constexpr uint64_t kNever = ~uint64_t(0);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    TimerLink         slots_[kLevels * kSlots];
+    uint64_t          occupied_[kLevels]{}; // may keep bits of slots emptied by destroyed timers
+    uint64_t          now_{};               // last processed tick
+    Clock::time_point start_{Clock::now()};
+
+public:
+    TimerWheel() = default;
+    TimerWheel(const TimerWheel & )             = delete;
+    TimerWheel & operator=(const TimerWheel & ) = delete;
+
+    /// Current tick by the clock, the wheel may lag behind it until advance()
+    uint64_t clock() const noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_).count();
+    }
+
+    void add(EPollTimer &timer, uint64_t deadline) noexcept
+    {
+        timer.deadline_ = std::max(deadline, now_ + 1);
+        timer.expired_  = false;
+        place_(timer);
+    }
+
+    void cancel(EPollTimer &timer) noexcept
+    {
+        if (!timer.is_linked())
+            return;
+        auto *prev = timer.prev_;
+        timer.unlink();
+        // the slot head is the previous link of the last timer in the slot
+        if (!prev->next_ && std::less_equal<>()(slots_, prev) && std::less<>()(prev, slots_ + std::size(slots_)))
+        {
+            size_t i = prev - slots_;
+            occupied_[i / kSlots] &= ~(uint64_t(1) << (i % kSlots));
+        }
+    }
+
+    /// Tick the wheel has to be advanced to next, kNever if there are no timers
+    uint64_t next_due() const noexcept
+    {
+        uint64_t due = kNever;
+        for (size_t l = 0; l < kLevels; ++l)
+        {
+            if (!occupied_[l])
+                continue;
+            const size_t   shift = l * kSlotBits;
+            const uint64_t cur   = (now_ >> shift) & (kSlots - 1);
+            // slots before the current one come round in the next period of the level
+            const uint64_t offset = std::countr_zero(std::rotr(occupied_[l], (cur + 1) % kSlots));
+            due = std::min(due, ((now_ >> shift) + 1 + offset) << shift);
+        }
+        return due;
+    }
+
+    /// epoll_wait() timeout till the next deadline, -1 if there are no timers
+    int wait_timeout() const noexcept
+    {
+        uint64_t due = next_due();
+        if (due == kNever)
+            return -1;
+        uint64_t now = clock();
+        return due <= now ? 0 : static_cast<int>(std::min<uint64_t>(due - now, INT_MAX));
+    }
+
+    /// Move to the tick @p to resuming coroutines of expired timers by @p resume
+    template <typename TResume>
+    void advance(uint64_t to, TResume &&resume)
+    {
+        for (uint64_t due; (due = next_due()) <= to;)
+        {
+            now_ = due;
+            TimerLink expired;
+            for (size_t l = kLevels; l-- > 0;)
+            {
+                const size_t shift = l * kSlotBits;
+                const size_t cur   = (now_ >> shift) & (kSlots - 1);
+                if ((now_ & ((uint64_t(1) << shift) - 1)) || !(occupied_[l] >> cur & 1))
+                    continue;
+                occupied_[l] &= ~(uint64_t(1) << cur);
+                auto &head = slots_[l * kSlots + cur];
+                for (auto *link = std::exchange(head.next_, nullptr); link;)
+                {
+                    auto &timer = static_cast<EPollTimer&>(*link);
+                    link = link->next_;
+                    if (timer.deadline_ <= now_)
+                        expired.push_front(timer);
+                    else
+                        place_(timer);
+                }
+            }
+            fire_(expired, resume);
+        }
+        now_ = std::max(now_, to);
+    }
+
+    /// Resume all waiting coroutines by @p resume as if their timers expired
+    template <typename TResume>
+    void expire_all(TResume &&resume)
+    {
+        TimerLink expired;
+        for (size_t i = 0; i < std::size(slots_); ++i)
+        {
+            for (auto *link = std::exchange(slots_[i].next_, nullptr); link;)
+            {
+                auto &timer = static_cast<EPollTimer&>(*link);
+                link = link->next_;
+                expired.push_front(timer);
+            }
+        }
+        std::fill(std::begin(occupied_), std::end(occupied_), 0);
+        fire_(expired, resume);
+    }
+
+private:
+    void place_(EPollTimer &timer) noexcept
+    {
+        uint64_t deadline = std::min(timer.deadline_, now_ + kMaxSpan - (kMaxSpan >> kSlotBits));
+        size_t   l        = std::min<size_t>((std::bit_width(deadline ^ now_) - 1) / kSlotBits, kLevels - 1);
+        size_t   slot     = (deadline >> (l * kSlotBits)) & (kSlots - 1);
+        slots_[l * kSlots + slot].push_front(timer);
+        occupied_[l] |= uint64_t(1) << slot;
+    }
+
+    // a resumed coroutine may destroy timers still in the list, they unlink themselves
+    template <typename TResume>
+    static void fire_(TimerLink &expired, TResume &resume)
+    {
+        while (expired.next_)
+        {
+            auto &timer = static_cast<EPollTimer&>(*expired.next_);
+            timer.unlink();
+            timer.expired_ = true;
+            if (timer.coro_handle_) resume(timer.coro_handle_);
+        }
+    }
+};
+
+/// @brief Adaptive time a poller spins before blocking
+/// @details A blocking wait ended by work within the max budget means spinning longer
+/// would have caught it, so the budget doubles; longer waits halve it, so a quiet loop
+/// goes back to sleeping in the kernel
+class SpinBudget
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::nanoseconds kMinSpin{1'000};
+
+private:
+    std::chrono::nanoseconds max_{};
+    std::chrono::nanoseconds cur_{};
+
+public:
+    bool enabled()                      const noexcept { return max_.count() > 0; }
+    std::chrono::nanoseconds max()      const noexcept { return max_; }
+    std::chrono::nanoseconds current()  const noexcept { return cur_; }
+
+    /// 0 disables spinning, the budget starts at the max
+    void configure(std::chrono::nanoseconds max) noexcept
+    {
+        max_ = std::max(max, std::chrono::nanoseconds{});
+        cur_ = max_;
+    }
+
+    void on_blocked(std::chrono::nanoseconds blocked) noexcept
+    {
+        if (blocked <= max_)
+            cur_ = std::min(max_, std::max(cur_ * 2, kMinSpin));
+        else if ((cur_ /= 2) < kMinSpin)
+            cur_ = {};
+    }
+
+    /// Call @p ready with pause backoff till it's true or the budget, capped by
+    /// @p timeout_ms unless negative, runs out
+    template <typename TReady>
+    bool spin(TReady &&ready, int timeout_ms)
+    {
+        auto budget = cur_;
+        if (timeout_ms >= 0)
+            budget = std::min<std::chrono::nanoseconds>(budget, std::chrono::milliseconds(timeout_ms));
+        if (budget.count() <= 0)
+            return false;
+
+        constexpr unsigned kMaxPauses = 64;
+        const auto deadline = Clock::now() + budget;
+        for (unsigned pauses = 1; ; pauses = std::min(pauses * 2, kMaxPauses))
+        {
+            if (ready())
+                return true;
+            if (Clock::now() >= deadline)
+                return false;
+            for (unsigned i = 0; i < pauses; ++i)
+                _mm_pause();
+        }
+    }
+};
+
+/// Work handed to a poller by other threads, an intrusive node of MPSCQueue
+struct PostedTask
+{
+    std::atomic<PostedTask*> next_{};
+    void (*invoke_)(PostedTask *task, bool run); // run or just release on poller destruction
+
+    explicit PostedTask(void (*invoke)(PostedTask*, bool)) noexcept : invoke_{invoke} {}
+};
+
+template <typename TFunc>
+struct PostedCallable : PostedTask
+{
+    TFunc func_;
+
+    template <typename TArg>
+    explicit PostedCallable(TArg &&func) : PostedTask(&invoke), func_(std::forward<TArg>(func)) {}
+
+    static void invoke(PostedTask *task, bool run)
+    {
+        std::unique_ptr<PostedCallable> self(static_cast<PostedCallable*>(task));
+        if (run)
+            self->func_();
+    }
+};
+
+/// @brief Intrusive lock-free multi-producer single-consumer queue (D. Vyukov)
+/// @details push() is one exchange and wait-free. pop() may miss a node whose producer is
+/// between its two steps, that producer wakes the consumer after finishing
+class MPSCQueue
+{
+    std::atomic<PostedTask*> head_; // last pushed
+    PostedTask              *tail_; // next to pop, consumer only
+    PostedTask               stub_{nullptr};
+
+public:
+    MPSCQueue() noexcept : head_{&stub_}, tail_{&stub_} {}
+
+    MPSCQueue(const MPSCQueue & )             = delete;
+    MPSCQueue & operator=(const MPSCQueue & ) = delete;
+
+    void push(PostedTask &task) noexcept
+    {
+        task.next_.store(nullptr, std::memory_order_relaxed);
+        head_.exchange(&task, std::memory_order_acq_rel)->next_.store(&task, std::memory_order_release);
+    }
+
+    PostedTask * pop() noexcept
+    {
+        PostedTask *tail = tail_;
+        PostedTask *next = tail->next_.load(std::memory_order_acquire);
+        if (tail == &stub_)
+        {
+            if (!next)
+                return nullptr;
+            tail_ = tail = next;
+            next  = next->next_.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire))
+            return nullptr; // a producer is linking after tail
+        // tail is the last one, put the stub behind it to take it out
+        push(stub_);
+        next = tail->next_.load(std::memory_order_acquire);
+        if (!next)
+            return nullptr;
+        tail_ = next;
+        return tail;
+    }
+};
+
+/// @brief Minimal io_uring: both rings in one mapping, submissions are published in batches by enter()
+/// @details Requires IORING_FEAT_SINGLE_MMAP, NODROP and EXT_ARG (Linux 5.11), create() returns
+/// nullptr otherwise or if io_uring is disabled, so the caller stays on epoll
+class URing
+{
+    int           fd_{-1};
+    void         *rings_{MAP_FAILED};
+    size_t        rings_size_{};
+    io_uring_sqe *sqes_{};
+    size_t        sqes_size_{};
+    unsigned     *sq_head_{};
+    unsigned     *sq_tail_{};
+    unsigned      sq_mask_{};
+    unsigned      sq_entries_{};
+    unsigned      sq_local_tail_{}; // sqes up to it are filled, but not published yet
+    unsigned     *cq_head_{};
+    unsigned     *cq_tail_{};
+    unsigned      cq_mask_{};
+    io_uring_cqe *cqes_{};
+
+    URing() = default;
+
+public:
+    static std::unique_ptr<URing> create(unsigned entries)
+    {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_CLAMP;
+        int fd = ::syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0)
+            return nullptr;
+
+        std::unique_ptr<URing> ring(new URing);
+        ring->fd_ = fd;
+        constexpr uint32_t kRequired = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+        if ((params.features & kRequired) != kRequired)
+            return nullptr;
+
+        ring->rings_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                     params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        ring->rings_ = ::mmap(nullptr, ring->rings_size_, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (ring->rings_ == MAP_FAILED)
+            return nullptr;
+        ring->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = ::mmap(nullptr, ring->sqes_size_, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return nullptr;
+        ring->sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto *base = static_cast<char*>(ring->rings_);
+        ring->sq_head_    = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        ring->sq_tail_    = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        ring->sq_mask_    = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        ring->sq_entries_ = params.sq_entries;
+        ring->cq_head_    = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        ring->cq_tail_    = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        ring->cq_mask_    = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        ring->cqes_       = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+        ring->sq_local_tail_ = *ring->sq_tail_;
+        // sqe i is always at the ring position i
+        auto *array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        for (unsigned i = 0; i < params.sq_entries; ++i)
+            array[i] = i;
+        return ring;
+    }
+
+    ~URing()
+    {
+        if (sqes_)
+            ::munmap(sqes_, sqes_size_);
+        if (rings_ != MAP_FAILED)
+            ::munmap(rings_, rings_size_);
+        ::close(fd_);
+    }
+
+    URing(const URing & )             = delete;
+    URing & operator=(const URing & ) = delete;
+
+    /// Make room for @p n sqes in a row, submitting the filled ones if needed
+    void reserve(unsigned n)
+    {
+        if (sq_entries_ - (sq_local_tail_ - std::atomic_ref(*sq_head_).load(std::memory_order_acquire)) < n)
+            enter(0, -1);
+    }
+
+    /// Zeroed sqe, there MUST be room for it
+    io_uring_sqe * get_sqe() noexcept
+    {
+        auto *sqe = sqes_ + (sq_local_tail_++ & sq_mask_);
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    /// Submit the filled sqes and wait for @p min_complete completions up to @p timeout_ms
+    /// @return io_uring_enter() result, -1 and ETIME on timeout
+    int enter(unsigned min_complete, int timeout_ms) noexcept
+    {
+        unsigned to_submit = sq_local_tail_ - *sq_tail_;
+        if (!to_submit && !min_complete)
+            return 0;
+        std::atomic_ref(*sq_tail_).store(sq_local_tail_, std::memory_order_release);
+
+        unsigned                flags = 0;
+        io_uring_getevents_arg  arg{};
+        __kernel_timespec       ts{};
+        if (min_complete)
+        {
+            flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+            if (timeout_ms >= 0)
+            {
+                ts.tv_sec  = timeout_ms / 1000;
+                ts.tv_nsec = (timeout_ms % 1000) * 1'000'000ll;
+                arg.ts     = reinterpret_cast<uintptr_t>(&ts);
+            }
+        }
+        return ::syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags,
+                         min_complete ? &arg : nullptr, sizeof(arg));
+    }
+
+    bool has_cqe() const noexcept
+    {
+        return *cq_head_ != std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+    }
+
+    /// Take the oldest completion, one at a time, so a handler may wait for its own one
+    bool pop_cqe(io_uring_cqe &cqe) noexcept
+    {
+        unsigned head = *cq_head_;
+        if (head == std::atomic_ref(*cq_tail_).load(std::memory_order_acquire))
+            return false;
+        cqe = cqes_[head & cq_mask_];
+        std::atomic_ref(*cq_head_).store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    int register_(unsigned opcode, const void *arg, unsigned nr) noexcept
+    {
+        return ::syscall(__NR_io_uring_register, fd_, opcode, arg, nr);
+    }
+};
+
+} // namespace detail
+
+/// @brief Fixed size read buffers carved from aligned slabs, lent to reads only when data is ready
+/// @details Slabs are allocated on demand and kept till the pool dies or trim() finds no buffer
+/// lent, free buffers are an intrusive LIFO list, so the hottest one is reused first.
+/// The pool belongs to the poller thread: buffers are borrowed and returned there only
+class ReadBufferPool
+{
+    using Allocator = posix::AlignedAllocator<char, 4096>;
+
+    struct FreeBuffer
+    {
+        FreeBuffer *next;
+    };
+
+    size_t              buffer_size_;
+    size_t              slab_buffers_;
+    FreeBuffer         *free_{};
+    std::vector<char *> slabs_;
+    size_t              lent_{};
+    size_t              peak_lent_{};
+
+public:
+    /// @param buffer_size Bytes of a buffer, rounded up to the 64 bytes cache line
+    /// @param slab_buffers Buffers allocated at once when the free list is empty
+    explicit ReadBufferPool(size_t buffer_size = size_t(1) << 14, size_t slab_buffers = 64)
+        : buffer_size_{std::max(utils::align_up<size_t, 64>(buffer_size), sizeof(FreeBuffer))}
+        , slab_buffers_{std::max<size_t>(slab_buffers, 1)}
+    {}
+
+    ~ReadBufferPool()
+    {
+        assert(!lent_);
+        release_slabs_();
+    }
+
+    ReadBufferPool(const ReadBufferPool & )             = delete;
+    ReadBufferPool & operator=(const ReadBufferPool & ) = delete;
+
+    size_t buffer_size() const noexcept { return buffer_size_; }
+    size_t lent()        const noexcept { return lent_; }      // buffers held by consumers now
+    size_t peak_lent()   const noexcept { return peak_lent_; }
+    size_t capacity()    const noexcept { return slabs_.size() * slab_buffers_; } // buffers owned
+
+    char * acquire()
+    {
+        if (!free_) [[unlikely]]
+            add_slab_();
+        peak_lent_ = std::max(peak_lent_, ++lent_);
+        return reinterpret_cast<char *>(std::exchange(free_, free_->next));
+    }
+
+    void release(char *buffer) noexcept
+    {
+        assert(lent_);
+        --lent_;
+        free_ = ::new (buffer) FreeBuffer{free_};
+    }
+
+    /// Free all slabs if no buffer is lent, e.g. after a burst of reads
+    void trim() noexcept
+    {
+        if (!lent_)
+            release_slabs_();
+    }
+
+private:
+    void add_slab_()
+    {
+        char *slab = Allocator().allocate(buffer_size_ * slab_buffers_);
+        slabs_.push_back(slab);
+        for (size_t i = slab_buffers_; i--; )
+            free_ = ::new (slab + i * buffer_size_) FreeBuffer{free_};
+    }
+
+    void release_slabs_() noexcept
+    {
+        for (auto *slab : slabs_)
+            Allocator().deallocate(slab, buffer_size_ * slab_buffers_);
+        slabs_.clear();
+        free_ = nullptr;
+    }
+};
+
+/// @brief Data read into a ReadBufferPool buffer, the buffer goes back to the pool with it
+/// @details Holds no buffer after an error, timeout or stop, an empty span with a buffer is
+/// the end of file like try_read_some() returns it
+class PooledReadBuffer
+{
+    ReadBufferPool *pool_{};
+    char           *data_{};
+    size_t          size_{};
+
+public:
+    PooledReadBuffer() = default;
+    PooledReadBuffer(ReadBufferPool &pool, char *data, size_t size) noexcept
+        : pool_{&pool}, data_{data}, size_{size}
+    {}
+
+    ~PooledReadBuffer() { release(); }
+
+    PooledReadBuffer(PooledReadBuffer &&other) noexcept
+        : pool_{std::exchange(other.pool_, nullptr)}
+        , data_{std::exchange(other.data_, nullptr)}
+        , size_{std::exchange(other.size_, 0)}
+    {}
+
+    PooledReadBuffer & operator=(PooledReadBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            pool_ = std::exchange(other.pool_, nullptr);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    explicit operator bool() const noexcept { return data_; }
+
+    const char * data() const noexcept { return data_; }
+    size_t       size() const noexcept { return size_; }
+    std::span<const char> span() const noexcept { return {data_, size_}; }
+
+    /// Return the buffer to the pool, the span is invalid after it
+    void release() noexcept
+    {
+        if (data_)
+            pool_->release(std::exchange(data_, nullptr));
+        size_ = 0;
+    }
+};
+
+class EPollFdHandle
+{
+    friend class detail::EPollEvent;
+    friend class EPoller;
+
+    // for intrusive list
+    EPollFdHandle          *prev_{};
+    EPollFdHandle          *next_{};
+
+    detail::EPollWaiter     reader_;       // read_some_async, read_pooled_async, accept_async
+    detail::EPollWaiter     writer_;       // write_some_async, write_all_async, connect_async
+    int                     fd_{-1};
+    int                     error_{};      // errno of the last failed operation
+    bool                    uring_pending_{}; // read submitted to io_uring, its buffer is in use
+    int                     uring_res_{};  // completion result of the last io_uring read
+    int                     fixed_file_{-1}; // index in the io_uring registered files or -1
+    bool                    socket_{};     // written by send(), which takes MSG_NOSIGNAL
+    bool                   *destroyed_{};  // set by the destructor during a resume of the reader
+    detail::EPollEvent      event_;        // registers fd_, so MUST follow it
+
+public:
+    EPollFdHandle() = default;
+    /// @param events Directions to watch from the first wait, others are added on demand
+    /// @details The fd is registered edge triggered only when a coroutine has to wait for it.
+    /// One reader and one writer may wait at the same time, each is resumed by its own events.
+    /// On io_uring the fd stays in the registered file table till the handle is destroyed,
+    /// so closing it before doesn't release the file, e.g. a pipe reader sees no end of file
+    EPollFdHandle(int fd, EPoller &poller, uint32_t events);
+
+    ~EPollFdHandle();
+
+    EPollFdHandle(const EPollFdHandle & ) = delete;
+    EPollFdHandle & operator=(const EPollFdHandle & ) = delete;
+
+    int fd()    const noexcept { return fd_; }
+    int error() const noexcept { return error_; } // 0 or errno of the last failed operation
+
+    // Regular methods
+    // An empty span without data means no data now or an error reported by error()
+    std::span<const char> try_read_some(void *buffer, size_t capacity)
+    {
+        auto n = ::read(fd_, buffer, capacity);
+        if (n < 0)
+        {
+            if (!is_would_block_(errno))
+                error_ = errno;
+            return {};
+        }
+        return {static_cast<const char*>(buffer), static_cast<size_t>(n)};
+    }
+
+    // An empty span means the fd is full or an error reported by error()
+    // A socket with no peer fails with EPIPE, but a pipe with no reader raises SIGPIPE as write() does,
+    // ignore the signal to get EPIPE there too
+    std::span<const char> try_write_some(const void *buffer, size_t size)
+    {
+        auto n = socket_ ? ::send(fd_, buffer, size, MSG_NOSIGNAL) : ::write(fd_, buffer, size);
+        if (n < 0)
+        {
+            if (!is_would_block_(errno))
+                error_ = errno;
+            return {};
+        }
+        return {static_cast<const char*>(buffer), static_cast<size_t>(n)};
+    }
+
+    // Accepted sockets are non-blocking, an empty span means no pending connections or an error
+    std::span<const int> try_accept(int *fds, size_t capacity)
+    {
+        size_t n = 0;
+        while (n < capacity)
+        {
+            int fd = ::accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0)
+                fds[n++] = fd;
+            else if (errno != EINTR && errno != ECONNABORTED) // aborted one is skipped
+                break;
+        }
+        if (n < capacity && !is_would_block_(errno) && errno != ECONNABORTED)
+            error_ = errno;
+        return {fds, n};
+    }
+
+    // Awaitable methods
+    /// Wait for data and read it, error() is ETIMEDOUT if nothing came in @p timeout
+    /// @details On the io_uring backend the read itself is submitted, the timeout is a linked one
+    auto read_some_async(void *buffer, size_t capacity, std::chrono::milliseconds timeout = kNoTimeout)
+    {
+        struct Awaiter : detail::EPollOperation
+        {
+            EPollFdHandle            &epoll_hdl;
+            void                     *buf;
+            size_t                    cap;
+            std::chrono::milliseconds timeout;
+            detail::EPollTimer        timer{};
+            __kernel_timespec         uring_timeout{};
+            std::span<const char>     res{};
+            bool                      uring{};
+
+            static bool try_complete(detail::EPollOperation &op)
+            {
+                auto &self = static_cast<Awaiter&>(op);
+                self.res = self.epoll_hdl.try_read_some(self.buf, self.cap);
+                return self.res.data() || self.epoll_hdl.error_; // data, end of file or error
+            }
+
+            bool await_ready()
+            {
+                epoll_hdl.error_ = 0;
+                // an edge triggered fd may hold data reported before, so try it first
+                uring = epoll_hdl.uses_uring_();
+                return !uring && try_complete(*this);
+            }
+
+            std::span<const char> await_resume()
+            {
+                suspended = false;
+                epoll_hdl.release_(epoll_hdl.reader_);
+                if (uring)
+                    return epoll_hdl.uring_read_result_(buf);
+                epoll_hdl.disarm_timeout_(timer);
+                return res;
+            }
+
+            void await_suspend(std::coroutine_handle<> hdl)
+            {
+                suspended = true;
+                if (uring)
+                {
+                    epoll_hdl.reader_.coro_handle_ = hdl;
+                    epoll_hdl.submit_read_(buf, cap, timeout, uring_timeout);
+                    return;
+                }
+                epoll_hdl.wait_(epoll_hdl.reader_, EPOLLIN, hdl, this);
+                epoll_hdl.arm_timeout_(timer, timeout, hdl);
+            }
+
+            ~Awaiter()
+            {
+                if (suspended)
+                    epoll_hdl.abandon_(epoll_hdl.reader_);
+            }
+        };
+        return Awaiter{{&Awaiter::try_complete}, *this, buffer, capacity, timeout};
+    }
+
+    /// Wait for data and read it into a buffer borrowed from @p pool only once the fd is readable,
+    /// so idle connections hold no buffer. error() is ETIMEDOUT if nothing came in @p timeout
+    /// @details Readiness is waited for by epoll on both backends, a buffer taken for a read
+    /// finding nothing goes back to the pool at once
+    auto read_pooled_async(ReadBufferPool &pool, std::chrono::milliseconds timeout = kNoTimeout)
+    {
+        struct Awaiter : detail::EPollOperation
+        {
+            EPollFdHandle            &epoll_hdl;
+            ReadBufferPool           &pool;
+            std::chrono::milliseconds timeout;
+            detail::EPollTimer        timer{};
+            PooledReadBuffer          res{};
+
+            static bool try_complete(detail::EPollOperation &op)
+            {
+                auto &self = static_cast<Awaiter&>(op);
+                char *buf = self.pool.acquire();
+                auto read = self.epoll_hdl.try_read_some(buf, self.pool.buffer_size());
+                if (read.data()) // data or end of file
+                {
+                    self.res = PooledReadBuffer(self.pool, buf, read.size());
+                    return true;
+                }
+                self.pool.release(buf);
+                return self.epoll_hdl.error_;
+            }
+
+            bool await_ready()
+            {
+                epoll_hdl.error_ = 0;
+                return try_complete(*this);
+            }
+
+            void await_suspend(std::coroutine_handle<> hdl)
+            {
+                suspended = true;
+                epoll_hdl.wait_(epoll_hdl.reader_, EPOLLIN, hdl, this);
+                epoll_hdl.arm_timeout_(timer, timeout, hdl);
+            }
+
+            ~Awaiter()
+            {
+                if (suspended)
+                    epoll_hdl.abandon_(epoll_hdl.reader_);
+            }
+
+            PooledReadBuffer await_resume() noexcept
+            {
+                suspended = false;
+                epoll_hdl.release_(epoll_hdl.reader_);
+                epoll_hdl.disarm_timeout_(timer);
+                return std::move(res);
+            }
+        };
+        return Awaiter{{&Awaiter::try_complete}, *this, pool, timeout};
+    }
+
+    /// Write at least one byte, waiting for EPOLLOUT if the fd is full
+    /// @return written prefix of the buffer, empty on error, timeout or stop
+    auto write_some_async(const void *buffer, size_t size, std::chrono::milliseconds timeout = kNoTimeout)
+    {
+        return WriteAwaiter<false>{{&WriteAwaiter<false>::try_complete}, *this,
+                                   static_cast<const char*>(buffer), size, timeout};
+    }
+
+    /// Write the whole buffer resuming the caller once, partial writes are continued on EPOLLOUT
+    /// @return written prefix of the buffer, shorter than @p size on error, timeout or stop
+    auto write_all_async(const void *buffer, size_t size, std::chrono::milliseconds timeout = kNoTimeout)
+    {
+        return WriteAwaiter<true>{{&WriteAwaiter<true>::try_complete}, *this,
+                                  static_cast<const char*>(buffer), size, timeout};
+    }
+
+    /// Accept pending connections of a listening socket, at least one
+    /// @return accepted non-blocking fds, empty on error, timeout or stop
+    auto accept_async(int *fds, size_t capacity, std::chrono::milliseconds timeout = kNoTimeout)
+    {
+        struct Awaiter : detail::EPollOperation
+        {
+            EPollFdHandle            &epoll_hdl;
+            int                      *fds;
+            size_t                    cap;
+            std::chrono::milliseconds timeout;
+            detail::EPollTimer        timer{};
+            std::span<const int>      res{};
+
+            static bool try_complete(detail::EPollOperation &op)
+            {
+                auto &self = static_cast<Awaiter&>(op);
+                self.res = self.epoll_hdl.try_accept(self.fds, self.cap);
+                return !self.res.empty() || self.epoll_hdl.error_;
+            }
+
+            bool await_ready()
+            {
+                epoll_hdl.error_ = 0;
+                return try_complete(*this);
+            }
+
+            void await_suspend(std::coroutine_handle<> hdl)
+            {
+                suspended = true;
+                epoll_hdl.wait_(epoll_hdl.reader_, EPOLLIN, hdl, this);
+                epoll_hdl.arm_timeout_(timer, timeout, hdl);
+            }
+
+            ~Awaiter()
+            {
+                if (suspended)
+                    epoll_hdl.abandon_(epoll_hdl.reader_);
+            }
+
+            std::span<const int> await_resume() noexcept
+            {
+                suspended = false;
+                epoll_hdl.release_(epoll_hdl.reader_);
+                epoll_hdl.disarm_timeout_(timer);
+                return res;
+            }
+        };
+        return Awaiter{{&Awaiter::try_complete}, *this, fds, capacity, timeout};
+    }
+
+    /// Connect the non-blocking socket
+    /// @return 0 or errno, ETIMEDOUT on timeout and ECANCELED on stop
+    auto connect_async(const sockaddr *addr, socklen_t addr_len, std::chrono::milliseconds timeout = kNoTimeout)
+    {
+        struct Awaiter : detail::EPollOperation
+        {
+            EPollFdHandle            &epoll_hdl;
+            const sockaddr           *addr;
+            socklen_t                 addr_len;
+            std::chrono::milliseconds timeout;
+            detail::EPollTimer        timer{};
+            int                       res{ECANCELED};
+
+            static bool try_complete(detail::EPollOperation &op)
+            {
+                auto &self = static_cast<Awaiter&>(op);
+                int       err{};
+                socklen_t len = sizeof(err);
+                if (::getsockopt(self.epoll_hdl.fd_, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+                    err = errno;
+                if (err == EINPROGRESS || err == EALREADY)
+                    return false;
+                self.res = err;
+                return true;
+            }
+
+            bool await_ready()
+            {
+                epoll_hdl.error_ = 0;
+                if (::connect(epoll_hdl.fd_, addr, addr_len) == 0)
+                    res = 0;
+                else if (errno != EINPROGRESS && errno != EINTR)
+                    res = errno;
+                else
+                    return false;
+                return true;
+            }
+
+            void await_suspend(std::coroutine_handle<> hdl)
+            {
+                suspended = true;
+                epoll_hdl.wait_(epoll_hdl.writer_, EPOLLOUT, hdl, this);
+                epoll_hdl.arm_timeout_(timer, timeout, hdl);
+            }
+
+            ~Awaiter()
+            {
+                if (suspended)
+                    epoll_hdl.abandon_(epoll_hdl.writer_);
+            }
+
+            int await_resume()
+            {
+                suspended = false;
+                epoll_hdl.release_(epoll_hdl.writer_);
+                if (epoll_hdl.disarm_timeout_(timer))
+                    res = ETIMEDOUT;
+                if (res)
+                    epoll_hdl.error_ = res;
+                return res;
+            }
+        };
+        return Awaiter{{&Awaiter::try_complete}, *this, addr, addr_len, timeout};
+    }
+
+    /// Move up to @p len bytes from @p src to @p dst with splice(2), one of them MUST be a pipe
+    /// @details The data doesn't pass through user space. Waits for whichever side blocks,
+    /// readable @p src or writable @p dst, so the coroutine takes the reader slot of one and
+    /// the writer slot of the other
+    /// @return moved bytes, 0 at the end of @p src or on error, timeout or stop, error() of
+    /// both handles is the errno then
+    friend auto splice_async(EPollFdHandle &src, EPollFdHandle &dst, size_t len,
+                             std::chrono::milliseconds timeout = kNoTimeout)
+    {
+        return TransferAwaiter<false>{{&TransferAwaiter<false>::try_complete}, src, dst, len, timeout};
+    }
+
+    /// Copy up to @p len bytes from pipe @p src to pipe @p dst with tee(2), not consuming them
+    /// @return as splice_async()
+    friend auto tee_async(EPollFdHandle &src, EPollFdHandle &dst, size_t len,
+                          std::chrono::milliseconds timeout = kNoTimeout)
+    {
+        return TransferAwaiter<true>{{&TransferAwaiter<true>::try_complete}, src, dst, len, timeout};
+    }
+
+private:
+    static bool is_would_block_(int err) noexcept
+    {
+        return err == EAGAIN || err == EWOULDBLOCK || err == EINTR;
+    }
+
+    template <bool kTee>
+    struct TransferAwaiter : detail::EPollOperation
+    {
+        EPollFdHandle            &src;
+        EPollFdHandle            &dst;
+        size_t                    len;
+        std::chrono::milliseconds timeout;
+        detail::EPollTimer        timer{};
+        size_t                    res{};
+
+        static bool try_complete(detail::EPollOperation &op)
+        {
+            auto &self = static_cast<TransferAwaiter&>(op);
+            ssize_t n;
+            if constexpr (kTee)
+                n = ::tee(self.src.fd_, self.dst.fd_, self.len, SPLICE_F_NONBLOCK);
+            else
+                n = ::splice(self.src.fd_, nullptr, self.dst.fd_, nullptr, self.len,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n >= 0)
+            {
+                self.res = static_cast<size_t>(n);
+                return true;
+            }
+            // EAGAIN doesn't tell which side is the one to wait for
+            if (is_would_block_(errno))
+                return false;
+            self.src.error_ = self.dst.error_ = errno;
+            return true;
+        }
+
+        bool await_ready()
+        {
+            src.error_ = dst.error_ = 0;
+            return try_complete(*this);
+        }
+
+        void await_suspend(std::coroutine_handle<> hdl)
+        {
+            suspended = true;
+            src.wait_(src.reader_, EPOLLIN, hdl, this);
+            dst.wait_(dst.writer_, EPOLLOUT, hdl, this);
+            src.arm_timeout_(timer, timeout, hdl);
+        }
+
+        ~TransferAwaiter()
+        {
+            if (!suspended)
+                return;
+            src.abandon_(src.reader_);
+            dst.abandon_(dst.writer_);
+        }
+
+        size_t await_resume()
+        {
+            suspended = false;
+            release_(src.reader_);
+            release_(dst.writer_);
+            if (src.disarm_timeout_(timer))
+                dst.error_ = ETIMEDOUT;
+            return res;
+        }
+    };
+
+    template <bool kAll>
+    struct WriteAwaiter : detail::EPollOperation
+    {
+        EPollFdHandle            &epoll_hdl;
+        const char               *buf;
+        size_t                    size;
+        std::chrono::milliseconds timeout;
+        detail::EPollTimer        timer{};
+        size_t                    done{};
+
+        static bool try_complete(detail::EPollOperation &op)
+        {
+            auto &self = static_cast<WriteAwaiter&>(op);
+            while (self.done < self.size)
+            {
+                auto res = self.epoll_hdl.try_write_some(self.buf + self.done, self.size - self.done);
+                if (res.empty())
+                    return self.epoll_hdl.error_ || (!kAll && self.done);
+                self.done += res.size();
+                if constexpr (!kAll)
+                    return true;
+            }
+            return true;
+        }
+
+        bool await_ready()
+        {
+            epoll_hdl.error_ = 0;
+            return try_complete(*this);
+        }
+
+        void await_suspend(std::coroutine_handle<> hdl)
+        {
+            suspended = true;
+            epoll_hdl.wait_(epoll_hdl.writer_, EPOLLOUT, hdl, this);
+            epoll_hdl.arm_timeout_(timer, timeout, hdl);
+        }
+
+        ~WriteAwaiter()
+        {
+            if (suspended)
+                epoll_hdl.abandon_(epoll_hdl.writer_);
+        }
+
+        std::span<const char> await_resume()
+        {
+            suspended = false;
+            epoll_hdl.release_(epoll_hdl.writer_);
+            epoll_hdl.disarm_timeout_(timer);
+            return {buf, done};
+        }
+    };
+
+    void arm_timeout_(detail::EPollTimer &timer, std::chrono::milliseconds timeout, std::coroutine_handle<> hdl);
+    // @return true if the timer expired, error() is ETIMEDOUT then
+    bool disarm_timeout_(detail::EPollTimer &timer);
+
+    bool uses_uring_() const noexcept;
+    void submit_read_(void *buffer, size_t capacity, std::chrono::milliseconds timeout, __kernel_timespec &ts);
+    std::span<const char> uring_read_result_(void *buffer);
+
+    void wait_(detail::EPollWaiter &waiter, uint32_t direction, std::coroutine_handle<> hdl,
+               detail::EPollOperation *op)
+    {
+        event_.arm(direction);
+        waiter.coro_handle_ = hdl;
+        waiter.op_          = op;
+    }
+
+    static void release_(detail::EPollWaiter &waiter) noexcept
+    {
+        waiter.coro_handle_ = std::coroutine_handle<>();
+        waiter.op_          = nullptr;
+    }
+
+    // the coroutine in @p waiter is destroyed suspended, e.g. a task dropped by when_any;
+    // a submitted read is cancelled and waited for, the kernel writes into its buffer till then
+    void abandon_(detail::EPollWaiter &waiter) noexcept;
+
+    // retry the pending I/O, the wakeup may be spurious for it
+    static std::coroutine_handle<> ready_(detail::EPollWaiter &waiter, bool woken)
+    {
+        if (!woken || !waiter.coro_handle_) return {};
+        if (waiter.op_ && !waiter.op_->try_complete(*waiter.op_)) return {};
+        return waiter.coro_handle_;
+    }
+
+    // @return false if the coroutine destroyed the handle
+    bool resume_alive_(std::coroutine_handle<> hdl);
+
+    void try_resume(uint32_t events);
+    void force_resume();
+};
+
+/// @brief Reactor loop counters, written by the polling thread and readable from any
+/// @details Durations are taken in TSC cycles and converted in the snapshot. Histograms are
+/// logarithmic: bucket i counts values of bit width i, durations in cycles. A round is
+/// one poll(): the wait, blocked, and the dispatch of what it returned, busy. Loop lag is
+/// the busy time of a round, the delay an arrival during it sees before the next wait
+struct ReactorMetrics
+{
+    static constexpr size_t kBuckets = 40;
+
+    struct Snapshot
+    {
+        size_t      waits;            // epoll_wait() or io_uring_enter() calls
+        size_t      events;           // epoll events and io_uring completions
+        size_t      resumes;          // coroutines resumed by handle events, timers and schedule_on(),
+                                      // other posted callables aren't timed
+        uint64_t    blocked_ns;       // in waits including busy poll spins
+        uint64_t    busy_ns;          // dispatching
+        uint64_t    max_resume_ns;
+        const void *slowest_frame;    // coroutine frame of the longest resume
+        double      cycles_per_ns;    // to read the histograms
+        size_t      events_per_wait[kBuckets];
+        size_t      resume_hist[kBuckets];
+        size_t      loop_lag_hist[kBuckets];
+    };
+
+    std::atomic<size_t>      waits{};
+    std::atomic<size_t>      events{};
+    std::atomic<size_t>      resumes{};
+    std::atomic<uint64_t>    blocked{};
+    std::atomic<uint64_t>    busy{};
+    std::atomic<uint64_t>    max_resume{};
+    std::atomic<const void*> slowest_frame{};
+    std::atomic<size_t>      events_per_wait[kBuckets]{};
+    std::atomic<size_t>      resume_hist[kBuckets]{};
+    std::atomic<size_t>      loop_lag_hist[kBuckets]{};
+
+private:
+    // cycles per ns are measured over the lifetime of the counters
+    uint64_t                              start_tsc_{__rdtsc()};
+    std::chrono::steady_clock::time_point start_time_{std::chrono::steady_clock::now()};
+    uint64_t                              woken_{};
+
+public:
+    static uint64_t now() noexcept { return __rdtsc(); }
+
+    void on_woken(uint64_t wait_start) noexcept
+    {
+        woken_ = now();
+        add_(waits, 1);
+        add_(blocked, woken_ - wait_start);
+    }
+
+    void on_events(size_t n) noexcept
+    {
+        add_(events, n);
+        add_(events_per_wait[bucket_(n)], 1);
+    }
+
+    void on_round_end() noexcept
+    {
+        uint64_t lag = now() - woken_;
+        add_(busy, lag);
+        add_(loop_lag_hist[bucket_(lag)], 1);
+    }
+
+    void on_resume(const void *frame, uint64_t cycles) noexcept
+    {
+        add_(resumes, 1);
+        add_(resume_hist[bucket_(cycles)], 1);
+        if (cycles > max_resume.load(std::memory_order_relaxed))
+        {
+            max_resume.store(cycles, std::memory_order_relaxed);
+            slowest_frame.store(frame, std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot snapshot() const noexcept
+    {
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time_);
+        double cycles_per_ns = elapsed.count() > 0 ? double(__rdtsc() - start_tsc_) / elapsed.count() : 1;
+        auto ns = [cycles_per_ns](const std::atomic<uint64_t> &v)
+        {
+            return static_cast<uint64_t>(v.load(std::memory_order_relaxed) / cycles_per_ns);
+        };
+        Snapshot res{waits.load(std::memory_order_relaxed),
+                     events.load(std::memory_order_relaxed),
+                     resumes.load(std::memory_order_relaxed),
+                     ns(blocked), ns(busy), ns(max_resume),
+                     slowest_frame.load(std::memory_order_relaxed),
+                     cycles_per_ns,
+                     {}, {}, {}};
+        for (size_t i = 0; i < kBuckets; ++i)
+        {
+            res.events_per_wait[i] = events_per_wait[i].load(std::memory_order_relaxed);
+            res.resume_hist[i]     = resume_hist[i].load(std::memory_order_relaxed);
+            res.loop_lag_hist[i]   = loop_lag_hist[i].load(std::memory_order_relaxed);
+        }
+        return res;
+    }
+
+private:
+    static size_t bucket_(uint64_t v) noexcept
+    {
+        return std::min<size_t>(std::bit_width(v), kBuckets - 1);
+    }
+
+    // the only writer is the polling thread, no need for a locked add
+    template <typename T>
+    static void add_(std::atomic<T> &counter, std::type_identity_t<T> v) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+};
+
+class EPoller
+{
+    friend class detail::EPollEvent;
+    friend class EPollFdHandle;
+
+    static constexpr uint64_t kWakeFlag = 1; // indicates posted tasks or stop, never a handle address
+
+    // io_uring user data tags, never a handle address either
+    static constexpr uint64_t kEPollReadyTag = 2; // the epoll fd itself is readable
+    static constexpr uint64_t kIgnoreTag     = 3; // cancels and linked timeouts
+
+    static constexpr unsigned kURingEntries  = 256;
+    static constexpr unsigned kMaxFixedFiles = 1'024;
+
+    EPollFdHandle fd_handlers_list_; // intrusive list of all events
+    int           epoll_fd_;
+    int           wake_fd_;   // eventfd for posted tasks and stop
+    bool          stop_flag_{};
+
+    std::atomic<size_t> load_{}; // registered handles, read by other threads to balance
+
+    // filled by any thread, run by poll()
+    detail::MPSCQueue   posted_;
+    std::atomic<bool>   wake_pending_{};   // wake_fd_ is written and not drained yet
+    std::atomic<bool>   stop_requested_{};
+
+    detail::TimerWheel timers_; // deadlines of sleeps and I/O timeouts, poll() waits till the next one
+    detail::SpinBudget spin_;   // busy poll before blocking, off by default
+
+    std::unique_ptr<ReactorMetrics> metrics_; // null unless enabled
+
+    // io_uring backend: reads are submitted to the ring, readiness of the epoll fd comes
+    // from the ring too, so poll() makes a single io_uring_enter() for both
+    std::unique_ptr<detail::URing>  uring_;
+    std::vector<int>                free_files_;     // free slots of the registered file table
+    std::vector<iovec>              buffers_;        // registered buffers
+    std::vector<io_uring_cqe>       deferred_;       // reaped while a handle waited for its own completion
+    size_t                          uring_inflight_{};
+    bool                            epoll_armed_{};  // poll request for the epoll fd is in the ring
+
+public:
+    enum class Backend : uint8_t
+    {
+        kEPoll,
+        kIOURing, // falls back to kEPoll if the kernel lacks io_uring
+    };
+
+    /// @param backend io_uring is opt-in, besides the I/O path it keeps a handle fd open till
+    /// the handle is destroyed, see EPollFdHandle
+    explicit EPoller(Backend backend = Backend::kEPoll) : epoll_fd_{::epoll_create1(0)}
+    {
+        // TODO: process error
+        if (epoll_fd_ < 0)
+            std::abort();
+        wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0)
+            std::abort();
+
+        epoll_event wake_event;
+        wake_event.data.u64 = kWakeFlag;
+        wake_event.events   = EPOLLIN | EPOLLET;
+
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &wake_event) < 0)
+        {
+            // TODO: process
+            std::abort();
+        }
+
+        if (backend == Backend::kIOURing)
+            uring_ = detail::URing::create(kURingEntries);
+        if (uring_)
+        {
+            // sparse table, handles fill it, without it reads just go by plain fds
+            std::vector<int> files(kMaxFixedFiles, -1);
+            if (uring_->register_(IORING_REGISTER_FILES, files.data(), kMaxFixedFiles) == 0)
+            {
+                for (int i = kMaxFixedFiles; i-- > 0;)
+                    free_files_.push_back(i);
+            }
+        }
+    }
+
+    ~EPoller()
+    {
+        assert(!fd_handlers_list_.next_);
+        while (auto *task = posted_.pop())
+            task->invoke_(task, false);
+        close(epoll_fd_);
+        close(wake_fd_);
+    }
+
+    EPoller(const EPoller & )             = delete;
+    EPoller & operator=(const EPoller & ) = delete;
+
+    void poll();
+
+    /// Poll until stop()
+    void run()
+    {
+        while (!stop_flag_)
+            poll();
+    }
+
+    /// @brief Spin checking for work up to @p max_spin before every blocking wait, 0 turns it off
+    /// @details The actual spin adapts to the gaps between arrivals and drops to none when idle.
+    /// It pays off only if the polling thread has a core of its own
+    void set_busy_poll(std::chrono::microseconds max_spin) noexcept { spin_.configure(max_spin); }
+
+    std::chrono::nanoseconds busy_poll_budget() const noexcept { return spin_.current(); }
+
+    /// Start counting, before other threads scrape metrics(), later calls keep the counters
+    void enable_metrics()
+    {
+        if (!metrics_)
+            metrics_ = std::make_unique<ReactorMetrics>();
+    }
+
+    /// May be called from any thread once enabled, empty before
+    std::optional<ReactorMetrics::Snapshot> metrics() const noexcept
+    {
+        if (!metrics_)
+            return std::nullopt;
+        return metrics_->snapshot();
+    }
+
+    /// May be called from any thread
+    void stop()
+    {
+        stop_requested_.store(true);
+        wake_();
+    }
+
+    bool is_stopped() const noexcept { return stop_flag_; }
+
+    Backend backend() const noexcept { return uring_ ? Backend::kIOURing : Backend::kEPoll; }
+
+    /// Register @p buffers with io_uring, reads into them skip pinning pages on every call
+    /// Replaces the previous set, no read into those may be in flight, an empty one just drops it
+    /// @return false on the epoll backend or if the kernel refused
+    bool register_buffers(std::span<const iovec> buffers)
+    {
+        if (!uring_)
+            return false;
+        if (!buffers_.empty())
+        {
+            uring_->register_(IORING_UNREGISTER_BUFFERS, nullptr, 0);
+            buffers_.clear();
+        }
+        if (buffers.empty())
+            return true;
+        if (uring_->register_(IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) < 0)
+            return false;
+        buffers_.assign(buffers.begin(), buffers.end());
+        return true;
+    }
+
+    /// Number of registered fd handles, safe to read from any thread
+    size_t load() const noexcept { return load_.load(std::memory_order_relaxed); }
+
+    /// Run @p func on this poller's thread from the next poll(), may be called from any thread
+    template <typename TFunc>
+    void post(TFunc &&func)
+    {
+        push_(*new detail::PostedCallable<std::decay_t<TFunc>>(std::forward<TFunc>(func)));
+    }
+
+    friend auto schedule_on(EPoller &poller);
+
+    /// Awaitable resuming the caller after @p duration, or on stop
+    auto sleep_for(std::chrono::milliseconds duration)
+    {
+        struct Awaiter
+        {
+            EPoller                  &poller;
+            std::chrono::milliseconds duration;
+            detail::EPollTimer        timer{};
+
+            bool await_ready() const noexcept { return duration.count() <= 0; }
+
+            void await_suspend(std::coroutine_handle<> hdl) noexcept
+            {
+                timer.coro_handle_ = hdl;
+                poller.timers_.add(timer, poller.timers_.clock() + duration.count());
+            }
+
+            void await_resume() noexcept { poller.timers_.cancel(timer); }
+        };
+        return Awaiter{*this, duration};
+    }
+
+private:
+    auto register_handler(EPollFdHandle &hdl, uint32_t events)
+    {
+        link_after_(fd_handlers_list_, hdl);
+        load_.fetch_add(1, std::memory_order_relaxed);
+
+        return detail::EPollEvent(*this, hdl, events);
+    }
+
+    void unregister_handler(EPollFdHandle &hdl) noexcept
+    {
+        unlink_(hdl);
+        load_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // intrusive list of handles
+    static void link_after_(EPollFdHandle &pos, EPollFdHandle &hdl) noexcept
+    {
+        hdl.prev_ = &pos;
+        hdl.next_ = pos.next_;
+        if (hdl.next_) hdl.next_->prev_ = &hdl;
+        pos.next_ = &hdl;
+    }
+
+    static void unlink_(EPollFdHandle &hdl) noexcept
+    {
+        if (hdl.prev_) hdl.prev_->next_ = hdl.next_;
+        if (hdl.next_) hdl.next_->prev_ = hdl.prev_;
+        hdl.prev_ = hdl.next_ = nullptr;
+    }
+
+    int  register_file_(int fd);
+    void unregister_file_(int index);
+    void submit_read_(EPollFdHandle &hdl, void *buffer, size_t capacity, const __kernel_timespec *timeout);
+    void cancel_read_(EPollFdHandle &hdl);
+    void wait_read_(EPollFdHandle &hdl);
+    void complete_(const io_uring_cqe &cqe);
+    void poll_uring_();
+    bool dispatch_(const epoll_event *events, size_t n);
+    void stop_all_();
+
+    void push_(detail::PostedTask &task)
+    {
+        posted_.push(task);
+        wake_();
+    }
+
+    // a burst of posts makes a single eventfd write, the poller clears the flag before draining
+    void wake_()
+    {
+        if (wake_pending_.exchange(true))
+            return;
+        uint64_t one = 1;
+        if (::write(wake_fd_, &one, sizeof(one)) < 0)
+            std::abort(); // TODO: process
+    }
+
+    void resume_(std::coroutine_handle<> hdl)
+    {
+        if (!metrics_)
+        {
+            hdl.resume();
+            return;
+        }
+        const void *frame = hdl.address(); // the coroutine may be gone after the resume
+        const auto start  = ReactorMetrics::now();
+        hdl.resume();
+        metrics_->on_resume(frame, ReactorMetrics::now() - start);
+    }
+
+    // timers resume their coroutines by resume_() too
+    auto resumer_() noexcept
+    {
+        return [this](std::coroutine_handle<> hdl) { resume_(hdl); };
+    }
+
+    // blocking wait feeding the spin budget with its duration
+    template <typename TWait>
+    int wait_blocking_(TWait &&wait)
+    {
+        if (!spin_.enabled())
+            return wait();
+        const auto start = detail::SpinBudget::Clock::now();
+        int res = wait();
+        spin_.on_blocked(detail::SpinBudget::Clock::now() - start);
+        return res;
+    }
+
+    // @return false on stop
+    bool on_wake_()
+    {
+        uint64_t cnt;
+        if (::read(wake_fd_, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+            std::abort(); // TODO: process
+        wake_pending_.store(false);
+        if (stop_requested_.load())
+        {
+            stop_all_();
+            return false;
+        }
+        run_posted_();
+        return true;
+    }
+
+    void run_posted_()
+    {
+        constexpr size_t kMaxPosted = 1'024; // tasks posting to their own poller can't starve I/O
+        for (size_t i = 0; i < kMaxPosted; ++i)
+        {
+            auto *task = posted_.pop();
+            if (!task)
+                return;
+            task->invoke_(task, true);
+        }
+        wake_(); // the rest goes in the next round
+    }
+};
+
+/// Awaitable suspending the caller and resuming it on @p poller's thread
+inline auto schedule_on(EPoller &poller)
+{
+    struct Awaiter : detail::PostedTask
+    {
+        EPoller                &poller;
+        std::coroutine_handle<> hdl;
+
+        explicit Awaiter(EPoller &p) noexcept : PostedTask(&invoke), poller{p} {}
+
+        static void invoke(detail::PostedTask *task, bool run)
+        {
+            auto &self = *static_cast<Awaiter*>(task);
+            if (run)
+                self.poller.resume_(self.hdl);
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            hdl = h;
+            poller.push_(*this);
+        }
+
+        void await_resume() const noexcept {}
+    };
+    return Awaiter(poller);
+}
+
+namespace detail
+{
+
+EPollEvent::EPollEvent(EPoller &poller, EPollFdHandle &fd_hdl, uint32_t events)
+    : poller_{&poller}
+    , fd_handle_{&fd_hdl}
+    , events_{events}
+{
+}
+
+EPollEvent::~EPollEvent()
+{
+    // if empty event or never waited on
+    if (!enabled_types_)
+        return;
+
+    ::epoll_ctl(poller_->epoll_fd_, EPOLL_CTL_DEL, fd_handle_->fd_, NULL);
+}
+
+void EPollEvent::modify(uint32_t events)
+{
+    epoll_event event;
+    event.data.ptr = fd_handle_;
+    event.events   = events;
+    // ADD and MOD both report the current readiness, so an edge before the registration isn't lost
+    const int op = enabled_types_ ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (::epoll_ctl(poller_->epoll_fd_, op, fd_handle_->fd_, &event) < 0
+        && !(op == EPOLL_CTL_ADD && errno == EPERM)) // regular files are always ready, nothing to wait
+    {
+        // TODO: process
+        std::abort();
+    }
+    enabled_types_ = events;
+}
+
+} // namespace detail
+
+EPollFdHandle::EPollFdHandle(int fd, EPoller &poller, uint32_t events)
+    : fd_{fd}
+    , event_{poller.register_handler(*this, events)}
+{
+    // edge triggered readiness is drained by I/O until EAGAIN, so the fd must not block
+    if (int flags = ::fcntl(fd, F_GETFL); flags >= 0 && !(flags & O_NONBLOCK))
+        ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    struct stat st;
+    socket_ = !::fstat(fd, &st) && S_ISSOCK(st.st_mode);
+    fixed_file_ = poller.register_file_(fd);
+}
+
+EPollFdHandle::~EPollFdHandle()
+{
+    if (destroyed_)
+        *destroyed_ = true;
+    if (auto *poller = event_.poller())
+    {
+        if (uring_pending_)
+            poller->wait_read_(*this); // the kernel may write into the buffer till the completion
+        poller->unregister_file_(fixed_file_);
+        poller->unregister_handler(*this);
+    }
+    else
+    {
+        // list head or empty handle
+        if (prev_) prev_->next_ = next_;
+        if (next_) next_->prev_ = prev_;
+    }
+}
+
+void EPollFdHandle::arm_timeout_(detail::EPollTimer &timer, std::chrono::milliseconds timeout,
+                                 std::coroutine_handle<> hdl)
+{
+    if (timeout.count() < 0)
+        return;
+    auto &timers = event_.poller()->timers_;
+    timer.coro_handle_ = hdl;
+    timers.add(timer, timers.clock() + timeout.count());
+}
+
+bool EPollFdHandle::disarm_timeout_(detail::EPollTimer &timer)
+{
+    event_.poller()->timers_.cancel(timer);
+    if (!timer.expired_)
+        return false;
+    error_ = ETIMEDOUT;
+    return true;
+}
+
+bool EPollFdHandle::resume_alive_(std::coroutine_handle<> hdl)
+{
+    bool destroyed = false;
+    auto *outer = std::exchange(destroyed_, &destroyed);
+    event_.poller()->resume_(hdl);
+    if (destroyed)
+    {
+        if (outer) *outer = true;
+        return false;
+    }
+    destroyed_ = outer;
+    return true;
+}
+
+void EPollFdHandle::try_resume(uint32_t events)
+{
+    // the io_uring read resumes the coroutine on its completion
+    auto reader = ready_(reader_, !uring_pending_ && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)));
+    if (reader && !resume_alive_(reader))
+        return;
+    // the writer is picked and its I/O done only after the reader ran, which may have destroyed
+    // its coroutine, e.g. when_any dropping it, or the handle itself
+    if (auto writer = ready_(writer_, events & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+        event_.poller()->resume_(writer);
+}
+
+void EPollFdHandle::force_resume()
+{
+    // the reader resumed first as by try_resume()
+    if (reader_.coro_handle_ && !uring_pending_ && !resume_alive_(reader_.coro_handle_))
+        return;
+    if (writer_.coro_handle_)
+        event_.poller()->resume_(writer_.coro_handle_);
+}
+
+void EPollFdHandle::abandon_(detail::EPollWaiter &waiter) noexcept
+{
+    if (&waiter == &reader_ && uring_pending_)
+        event_.poller()->wait_read_(*this);
+    release_(waiter);
+}
+
+bool EPollFdHandle::uses_uring_() const noexcept
+{
+    return event_.poller()->uring_ != nullptr;
+}
+
+void EPollFdHandle::submit_read_(void *buffer, size_t capacity, std::chrono::milliseconds timeout,
+                                 __kernel_timespec &ts)
+{
+    auto *poller = event_.poller();
+    const __kernel_timespec *link_timeout = nullptr;
+    if (timeout.count() >= 0)
+    {
+        ts.tv_sec    = timeout.count() / 1000;
+        ts.tv_nsec   = (timeout.count() % 1000) * 1'000'000ll;
+        link_timeout = &ts;
+    }
+    poller->submit_read_(*this, buffer, capacity, link_timeout);
+}
+
+std::span<const char> EPollFdHandle::uring_read_result_(void *buffer)
+{
+    if (uring_res_ >= 0)
+        return {static_cast<const char*>(buffer), static_cast<size_t>(uring_res_)};
+    // cancelled by the linked timeout or by stop
+    error_ = uring_res_ == -ECANCELED && !event_.poller()->is_stopped() ? ETIMEDOUT : -uring_res_;
+    return {};
+}
+
+int EPoller::register_file_(int fd)
+{
+    if (free_files_.empty())
+        return -1;
+    io_uring_files_update update{};
+    update.offset = free_files_.back();
+    update.fds    = reinterpret_cast<uintptr_t>(&fd);
+    if (uring_->register_(IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+        return -1;
+    free_files_.pop_back();
+    return update.offset;
+}
+
+void EPoller::unregister_file_(int index)
+{
+    if (index < 0)
+        return;
+    int fd = -1;
+    io_uring_files_update update{};
+    update.offset = index;
+    update.fds    = reinterpret_cast<uintptr_t>(&fd);
+    uring_->register_(IORING_REGISTER_FILES_UPDATE, &update, 1);
+    free_files_.push_back(index);
+}
+
+void EPoller::submit_read_(EPollFdHandle &hdl, void *buffer, size_t capacity, const __kernel_timespec *timeout)
+{
+    uring_->reserve(timeout ? 2 : 1); // a linked pair MUST go in one submission
+    auto *sqe = uring_->get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd     = hdl.fd_;
+    if (hdl.fixed_file_ >= 0)
+    {
+        sqe->fd     = hdl.fixed_file_;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+    sqe->addr      = reinterpret_cast<uintptr_t>(buffer);
+    sqe->len       = static_cast<uint32_t>(capacity);
+    sqe->off       = ~uint64_t(0); // current position, pipes and sockets have none
+    sqe->user_data = reinterpret_cast<uintptr_t>(&hdl);
+    for (size_t i = 0; i < buffers_.size(); ++i)
+    {
+        auto *begin = static_cast<char*>(buffers_[i].iov_base);
+        if (std::less_equal<>()(begin, buffer) &&
+            std::less_equal<>()(static_cast<char*>(buffer) + capacity, begin + buffers_[i].iov_len))
+        {
+            sqe->opcode    = IORING_OP_READ_FIXED;
+            sqe->buf_index = static_cast<uint16_t>(i);
+            break;
+        }
+    }
+    if (timeout)
+    {
+        sqe->flags |= IOSQE_IO_LINK;
+        auto *link = uring_->get_sqe();
+        link->opcode    = IORING_OP_LINK_TIMEOUT;
+        link->addr      = reinterpret_cast<uintptr_t>(timeout);
+        link->len       = 1;
+        link->user_data = kIgnoreTag;
+    }
+    hdl.uring_pending_ = true;
+    ++uring_inflight_;
+}
+
+void EPoller::cancel_read_(EPollFdHandle &hdl)
+{
+    uring_->reserve(1);
+    auto *sqe = uring_->get_sqe();
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = reinterpret_cast<uintptr_t>(&hdl);
+    sqe->user_data = kIgnoreTag;
+}
+
+void EPoller::wait_read_(EPollFdHandle &hdl)
+{
+    auto own = [&hdl](const io_uring_cqe &cqe) { return cqe.user_data == reinterpret_cast<uintptr_t>(&hdl); };
+    if (auto it = std::find_if(deferred_.begin(), deferred_.end(), own); it != deferred_.end())
+    {
+        deferred_.erase(it);
+    }
+    else
+    {
+        cancel_read_(hdl);
+        for (io_uring_cqe cqe; ;)
+        {
+            if (!uring_->pop_cqe(cqe))
+            {
+                uring_->enter(1, -1);
+                continue;
+            }
+            if (own(cqe))
+                break;
+            deferred_.push_back(cqe); // resuming others here would reenter the destroyed coroutine
+        }
+    }
+    hdl.uring_pending_ = false;
+    --uring_inflight_;
+}
+
+void EPoller::complete_(const io_uring_cqe &cqe)
+{
+    if (cqe.user_data == kEPollReadyTag)
+    {
+        epoll_armed_ = false;
+        return;
+    }
+    if (cqe.user_data == kIgnoreTag)
+        return;
+    auto &hdl = *reinterpret_cast<EPollFdHandle*>(cqe.user_data);
+    hdl.uring_pending_ = false;
+    hdl.uring_res_     = cqe.res;
+    --uring_inflight_;
+    if (hdl.reader_.coro_handle_) resume_(hdl.reader_.coro_handle_);
+}
+
+void EPoller::poll_uring_()
+{
+    if (!epoll_armed_)
+    {
+        uring_->reserve(1);
+        auto *sqe = uring_->get_sqe();
+        sqe->opcode        = IORING_OP_POLL_ADD;
+        sqe->fd            = epoll_fd_;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data     = kEPollReadyTag;
+        epoll_armed_       = true;
+    }
+    const uint64_t wait_start = metrics_ ? ReactorMetrics::now() : 0;
+    auto ready = [this] { return !deferred_.empty() || uring_->has_cqe(); };
+    if (spin_.enabled() && !ready())
+    {
+        uring_->enter(0, -1); // submit, completions are posted while spinning
+        spin_.spin(ready, timers_.wait_timeout());
+    }
+    // submissions of the last round and the wait in one call
+    int res = ready() ? uring_->enter(0, -1)
+                      : wait_blocking_([&] { return uring_->enter(1, timers_.wait_timeout()); });
+    if (res < 0 && errno != EINTR && errno != ETIME)
+    {
+        // TODO: process errors
+        std::abort();
+    }
+    if (metrics_) metrics_->on_woken(wait_start);
+
+    size_t completed = deferred_.size();
+    while (!deferred_.empty())
+    {
+        auto cqe = deferred_.back();
+        deferred_.pop_back();
+        complete_(cqe);
+    }
+    constexpr size_t kMaxCompletions = kURingEntries * 2;
+    bool epoll_ready = false;
+    io_uring_cqe cqe;
+    for (size_t i = 0; i < kMaxCompletions && uring_->pop_cqe(cqe); ++i, ++completed)
+    {
+        epoll_ready |= cqe.user_data == kEPollReadyTag;
+        complete_(cqe);
+    }
+    if (epoll_ready)
+    {
+        constexpr int kMaxEvents = 1'024;
+        epoll_event events[kMaxEvents];
+        int n = ::epoll_wait(epoll_fd_, events, kMaxEvents, 0);
+        if (metrics_) metrics_->on_events(completed + std::max(n, 0));
+        if (n > 0 && !dispatch_(events, n))
+            return;
+    }
+    else if (metrics_)
+    {
+        metrics_->on_events(completed);
+    }
+    timers_.advance(timers_.clock(), resumer_());
+    run_posted_();
+    if (metrics_) metrics_->on_round_end();
+}
+
+// @return false on stop
+bool EPoller::dispatch_(const epoll_event *events, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto &event = events[i];
+        if (event.data.u64 == kWakeFlag)
+        {
+            if (!on_wake_()) [[unlikely]]
+                return false;
+            continue;
+        }
+        // TODO: process error events
+        auto &fd_handle = *reinterpret_cast<EPollFdHandle*>(event.data.ptr);
+        fd_handle.try_resume(event.events);
+    }
+    return true;
+}
+
+void EPoller::stop_all_()
+{
+    // notify all to stop
+    stop_flag_ = true;
+    // a resumed coroutine may destroy its handle and the next ones, so walk with a cursor
+    // node, destroyed handles unlink themselves and the cursor stays valid
+    EPollFdHandle cursor;
+    link_after_(fd_handlers_list_, cursor);
+    while (auto *hdl = cursor.next_)
+    {
+        unlink_(cursor);
+        link_after_(*hdl, cursor);
+        if (hdl->uring_pending_)
+            cancel_read_(*hdl); // the reader is resumed by the completion below
+        hdl->force_resume();
+    }
+    while (uring_inflight_)
+    {
+        uring_->enter(1, -1);
+        while (!deferred_.empty())
+        {
+            auto cqe = deferred_.back();
+            deferred_.pop_back();
+            complete_(cqe);
+        }
+        for (io_uring_cqe cqe; uring_->pop_cqe(cqe);)
+            complete_(cqe);
+    }
+    timers_.expire_all(resumer_());
+}
+
+void EPoller::poll()
+{
+    if (uring_)
+    {
+        poll_uring_();
+        return;
+    }
+
+    constexpr int kMaxEvents = 1'024;
+    epoll_event events[kMaxEvents];
+    const uint64_t wait_start = metrics_ ? ReactorMetrics::now() : 0;
+    int n = 0;
+    if (!spin_.spin([&] { return (n = ::epoll_wait(epoll_fd_, events, kMaxEvents, 0)) != 0; },
+                    timers_.wait_timeout()))
+    {
+        n = wait_blocking_([&] { return ::epoll_wait(epoll_fd_, events, kMaxEvents, timers_.wait_timeout()); });
+    }
+    if (n < 0) [[unlikely]]
+    {
+        // TODO: process errors
+        if (errno != EINTR)
+            std::abort();
+        n = 0;
+    }
+    if (metrics_)
+    {
+        metrics_->on_woken(wait_start);
+        metrics_->on_events(n);
+    }
+    if (!dispatch_(events, n))
+        return;
+    // I/O first, so an operation completed in this round cancels its timeout
+    timers_.advance(timers_.clock(), resumer_());
+    run_posted_();
+    if (metrics_) metrics_->on_round_end();
+}
+
+/// @brief N pollers running on their own threads, pinned to the allowed cpus round robin
+/// @details Handles MUST be created and used on the thread of their poller, so a coroutine
+/// serving a new fd first moves to the poller picked by next() or least_loaded()
+/// with co_await schedule_on(poller) and only then registers the fd
+class EPollerGroup
+{
+    std::vector<std::unique_ptr<EPoller>> pollers_;
+    std::vector<std::thread>              threads_;
+    std::atomic<size_t>                   next_{};
+
+public:
+    explicit EPollerGroup(size_t n = std::thread::hardware_concurrency(),
+                          EPoller::Backend backend = EPoller::Backend::kEPoll)
+    {
+        pollers_.reserve(std::max<size_t>(n, 1));
+        for (size_t i = 0; i < std::max<size_t>(n, 1); ++i)
+            pollers_.push_back(std::make_unique<EPoller>(backend));
+    }
+
+    ~EPollerGroup()
+    {
+        stop();
+        join();
+    }
+
+    EPollerGroup(const EPollerGroup & )             = delete;
+    EPollerGroup & operator=(const EPollerGroup & ) = delete;
+
+    size_t size() const noexcept { return std::size(pollers_); }
+
+    EPoller & operator[](size_t i) noexcept { return *pollers_[i]; }
+
+    /// Round robin choice
+    EPoller & next() noexcept
+    {
+        return *pollers_[next_.fetch_add(1, std::memory_order_relaxed) % size()];
+    }
+
+    /// Poller with the fewest registered handles
+    EPoller & least_loaded() noexcept
+    {
+        auto *res = pollers_.front().get();
+        for (auto &p : pollers_)
+            if (p->load() < res->load())
+                res = p.get();
+        return *res;
+    }
+
+    /// Run every poller until stopped, thread i is pinned to the (i mod n)-th of the n cpus
+    /// the process may run on, as limited by taskset or a cgroup cpuset
+    void start(bool pin = true)
+    {
+        std::vector<int> cpus;
+        cpu_set_t        allowed;
+        if (pin && !::sched_getaffinity(0, sizeof(allowed), &allowed))
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                if (CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+        }
+        for (size_t i = 0; i < size(); ++i)
+        {
+            threads_.emplace_back([&poller = *pollers_[i]]
+            {
+                while (!poller.is_stopped())
+                    poller.poll();
+            });
+            if (!cpus.empty())
+            {
+                cpu_set_t cpu;
+                CPU_ZERO(&cpu);
+                CPU_SET(cpus[i % std::size(cpus)], &cpu);
+                ::pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpu), &cpu); // best effort
+            }
+        }
+    }
+
+    /// Signal every poller to stop, may be called from any thread
+    void stop()
+    {
+        for (auto &p : pollers_)
+            p->stop();
+    }
+
+    void join()
+    {
+        for (auto &t : threads_)
+            if (t.joinable())
+                t.join();
+        threads_.clear();
+    }
+};
+
+namespace detail
+{
+
+/// @brief Thread local size class free lists for coroutine frames
+/// @details Classes are multiples of a cache line up to 2 KB, larger frames go to the global
+/// operator new. A frame freed on another thread joins the lists of that thread
+class FramePool
+{
+    static constexpr size_t kGranularity = 64;
+    static constexpr size_t kClasses     = 32;
+    static constexpr size_t kMaxCached   = 256; // frames per class, the rest goes back to the heap
+
+    struct FreeFrame
+    {
+        FreeFrame *next;
+    };
+
+    FreeFrame *free_[kClasses]{};
+    size_t     cached_[kClasses]{};
+
+public:
+    static FramePool & local() noexcept
+    {
+        thread_local FramePool pool;
+        return pool;
+    }
+
+    FramePool() = default;
+    FramePool(const FramePool & )             = delete;
+    FramePool & operator=(const FramePool & ) = delete;
+
+    ~FramePool()
+    {
+        for (auto *&list : free_)
+            while (list)
+                ::operator delete(std::exchange(list, list->next));
+    }
+
+    void * allocate(size_t size)
+    {
+        size_t c = class_(size);
+        if (c >= kClasses)
+            return ::operator new(size);
+        if (auto *frame = free_[c])
+        {
+            free_[c] = frame->next;
+            --cached_[c];
+            return frame;
+        }
+        return ::operator new((c + 1) * kGranularity);
+    }
+
+    void deallocate(void *p, size_t size) noexcept
+    {
+        size_t c = class_(size);
+        if (c >= kClasses || cached_[c] == kMaxCached)
+        {
+            ::operator delete(p);
+            return;
+        }
+        free_[c] = ::new (p) FreeFrame{free_[c]};
+        ++cached_[c];
+    }
+
+private:
+    static constexpr size_t class_(size_t size) noexcept { return (size - 1) / kGranularity; }
+};
+
+/// Base of promises taking their frames from the FramePool
+struct PooledPromise
+{
+    static void * operator new(size_t size) { return FramePool::local().allocate(size); }
+    static void   operator delete(void *p, size_t size) noexcept { FramePool::local().deallocate(p, size); }
+};
+
+template <typename T>
+using NonVoid = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+} // namespace detail
+
+template <typename T = void>
+class Task;
 
 namespace detail
 {
 
-class EPollEvent
+struct TaskPromiseBase : PooledPromise
 {
-    EPoller       *poller_{};
-    EPollFdHandle *fd_handle_{};
-    uint32_t       enabled_types_{};
+    std::coroutine_handle<> continuation_{std::noop_coroutine()};
+    std::exception_ptr      exception_;
 
-public:
-    EPollEvent() = default;
-    EPollEvent(EPoller &poller, EPollFdHandle &fd_hdl, uint32_t events);
-    ~EPollEvent();
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
 
-    auto watched()        const { return enabled_types_; }
-    void watch(uint32_t events) { enabled_types_ = events;}
+        // symmetric transfer, a chain of completing tasks doesn't grow the stack
+        template <typename TPromise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<TPromise> hdl) noexcept
+        {
+            return hdl.promise().continuation_;
+        }
 
-    void modify(uint32_t events);
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter        final_suspend()   noexcept { return {}; }
+    void                unhandled_exception() noexcept { exception_ = std::current_exception(); }
 };
 
-} // namespace detail
+template <typename T>
+struct TaskPromise : TaskPromiseBase
+{
+    std::optional<T> value_;
 
-class EPollFdHandle
+    Task<T> get_return_object() noexcept;
+
+    template <typename U>
+        requires std::convertible_to<U&&, T>
+    void return_value(U &&value) { value_.emplace(std::forward<U>(value)); }
+
+    T result()
+    {
+        if (exception_)
+            std::rethrow_exception(exception_);
+        return std::move(*value_);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase
 {
-    friend class detail::EPollEvent;
-    friend class EPoller;
+    Task<void> get_return_object() noexcept;
 
-    // for intrusive list
-    EPollFdHandle          *prev_{};
-    EPollFdHandle          *next_{};
+    void return_void() noexcept {}
 
-    std::coroutine_handle<> coro_handle_;
-    detail::EPollEvent      event_;
-    int                     fd_;
+    void result()
+    {
+        if (exception_)
+            std::rethrow_exception(exception_);
+    }
+};
+
+} // namespace detail
 
+/// @brief Lazy coroutine started by co_await, resumes its awaiter on completion
+/// @details The awaiter is resumed by symmetric transfer, so deep await chains take no stack.
+/// The task owns its frame, frames come from the thread local FramePool
+template <typename T>
+class [[nodiscard]] Task
+{
 public:
-    EPollFdHandle() = default;
-    EPollFdHandle(int fd, EPoller &poller, uint32_t events);
+    using promise_type = detail::TaskPromise<T>;
+    using value_type   = T;
 
-    ~EPollFdHandle()
+private:
+    using Handle = std::coroutine_handle<promise_type>;
+
+    friend promise_type;
+
+    Handle handle_;
+
+    explicit Task(Handle hdl) noexcept : handle_{hdl} {}
+
+    template <bool kResult>
+    struct Awaiter
     {
-        printf("~EPollFdHandler() this = %p, prev_ = %p, next_ = %p\n", this, prev_, next_);
-        if (prev_) prev_->next_ = next_;
-        if (next_) next_->prev_ = prev_;
-    }
+        Handle handle;
 
-    EPollFdHandle(const EPollFdHandle & ) = delete;
-    EPollFdHandle & operator=(const EPollFdHandle & ) = delete;
+        bool await_ready() const noexcept { return handle.done(); }
 
-    // Regular methods
-    std::span<const char> try_read_some(void *buffer, size_t capacity)
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+        {
+            handle.promise().continuation_ = caller;
+            return handle;
+        }
+
+        decltype(auto) await_resume()
+        {
+            if constexpr (kResult)
+                return handle.promise().result();
+        }
+    };
+
+public:
+    Task() = default;
+
+    Task(Task &&other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+
+    Task & operator=(Task &&other) noexcept
     {
-        auto n = ::read(fd_, buffer, capacity);
-        if (n < 0)
+        if (this != &other)
         {
-            // TODO: process error
-            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
-                std::abort();
-            return {};
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
         }
-        return {static_cast<const char*>(buffer), static_cast<size_t>(n)};
+        return *this;
     }
 
-    // Awaitable methods
-    auto read_some_async(void *buffer, size_t capacity)
+    ~Task()
     {
-        struct Awaiter
-        {
-            EPollFdHandle  &epoll_hdl;
-            void           *buf;
-            size_t          cap;
+        if (handle_) handle_.destroy();
+    }
+
+    bool valid() const noexcept { return static_cast<bool>(handle_); }
+    bool done()  const noexcept { return handle_.done(); }
+
+    /// Run the task and take its result, rethrows its exception
+    auto operator co_await() noexcept { return Awaiter<true>{handle_}; }
+
+    /// Run the task, the result stays in it
+    auto when_ready() noexcept { return Awaiter<false>{handle_}; }
+};
+
+template <typename T>
+Task<T> detail::TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+inline Task<void> detail::TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+namespace detail
+{
+
+struct WhenLatch
+{
+    static constexpr size_t kNone = ~size_t(0);
+
+    std::atomic<size_t>     count;        // awaiting coroutine plus runners it waits for
+    bool                    any{};        // only the first finished runner counts
+    std::atomic<size_t>     winner{kNone};
+    std::coroutine_handle<> waiter{};
+};
+
+template <typename T>
+struct WhenSlot
+{
+    std::optional<NonVoid<T>> value;
+    std::exception_ptr        exception;
+
+    NonVoid<T> get()
+    {
+        if (exception)
+            std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
 
+/// Coroutine running one task of when_all/when_any and counting down the latch
+class WhenRunner
+{
+public:
+    struct promise_type : PooledPromise
+    {
+        WhenLatch *latch_{};
+        size_t     index_{};
 
+        struct FinalAwaiter
+        {
             bool await_ready() const noexcept { return false; }
 
-            std::span<const char> await_resume()
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> hdl) noexcept
             {
-                epoll_hdl.coro_handle_ = std::coroutine_handle<>();
-                return epoll_hdl.try_read_some(buf, cap);
+                auto &promise = hdl.promise();
+                auto &latch   = *promise.latch_;
+                size_t none   = WhenLatch::kNone;
+                bool   counts = !latch.any || latch.winner.compare_exchange_strong(none, promise.index_);
+                if (counts && latch.count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    return latch.waiter;
+                return std::noop_coroutine();
             }
 
-            void await_suspend(std::coroutine_handle<> hdl) noexcept
-            {
-                epoll_hdl.coro_handle_ = std::move(hdl);
-            }
+            void await_resume() const noexcept {}
         };
-        return Awaiter{*this, buffer, capacity};
-    }
+
+        WhenRunner          get_return_object() noexcept { return WhenRunner(Handle::from_promise(*this)); }
+        std::suspend_always initial_suspend()   noexcept { return {}; }
+        FinalAwaiter        final_suspend()     noexcept { return {}; }
+        void                return_void()       noexcept {}
+        void                unhandled_exception() noexcept { std::terminate(); } // runners catch all
+    };
 
 private:
-    void try_resume(uint32_t events)
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Handle handle_;
+
+    explicit WhenRunner(Handle hdl) noexcept : handle_{hdl} {}
+
+public:
+    WhenRunner(WhenRunner &&other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+    WhenRunner & operator=(WhenRunner && ) = delete;
+
+    // destroys the task of an unfinished runner too, which is how when_any cancels the rest
+    ~WhenRunner()
     {
-        if (!(events & event_.watched())) return;
-        // do nothing is if the coroutine doesn't suspended on async method of this class
-        if (coro_handle_) coro_handle_.resume();
+        if (handle_) handle_.destroy();
     }
 
-    void force_resume()
+    void start(WhenLatch &latch, size_t index)
     {
-        if (coro_handle_) coro_handle_.resume();
+        handle_.promise().latch_ = &latch;
+        handle_.promise().index_ = index;
+        handle_.resume();
     }
 };
 
-class EPoller
+template <typename T>
+WhenRunner when_runner(Task<T> task, WhenSlot<T> &slot)
 {
-    friend class detail::EPollEvent;
-    friend class EPollFdHandle;
-
-    static constexpr uint64_t kStopFlag = 0; // indicates stop signal
-
-    EPollFdHandle fd_handlers_list_; // intrusive list of all events
-    int           epoll_fd_;
-    int           stop_pipe_[2];
-    bool          stop_flag_{};
-
-public:
-    EPoller() : epoll_fd_{::epoll_create1(0)}
+    try
     {
-        // TODO: process error
-        if (epoll_fd_ < 0)
-            std::abort();
-        // TODO
-        if (::pipe(stop_pipe_) != 0)
-            std::abort();
-
-        epoll_event stop_event;
-        stop_event.data.u64 = kStopFlag;
-        stop_event.events   = EPOLLIN | EPOLLET;
-
-        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_pipe_[0], &stop_event) < 0)
+        if constexpr (std::is_void_v<T>)
         {
-            // TODO: process
-            std::abort();
+            co_await task;
+            slot.value.emplace();
+        }
+        else
+        {
+            slot.value.emplace(co_await task);
         }
     }
-
-    ~EPoller()
+    catch (...)
     {
-        printf("~EPoller() fd_handlers_list_ = %p, fd_handlers_list_.next_ = %p\n",
-                &fd_handlers_list_, fd_handlers_list_.next_);
-        assert(!fd_handlers_list_.next_);
-        close(epoll_fd_);
-        close(stop_pipe_[0]);
-        close(stop_pipe_[1]);
+        slot.exception = std::current_exception();
     }
+}
 
-    EPoller(const EPoller & )             = delete;
-    EPoller & operator=(const EPoller & ) = delete;
+template <size_t kN>
+struct WhenAwaiter
+{
+    WhenLatch  &latch;
+    WhenRunner  runners[kN];
 
-    void poll();
+    bool await_ready() const noexcept { return false; }
 
-    void stop()
+    bool await_suspend(std::coroutine_handle<> hdl)
     {
-        // TODO
-        if (::write(stop_pipe_[1], "1234567890", 10) < 0) // just write one symbol
-            std::abort();
-        printf("Stop signaled\n");
+        latch.waiter = hdl;
+        for (size_t i = 0; i < kN; ++i)
+            runners[i].start(latch, i);
+        // the awaiting coroutine holds one count, so runners finished inline can't resume it
+        return latch.count.fetch_sub(1, std::memory_order_acq_rel) != 1;
     }
 
-    bool is_stopped() const noexcept { return stop_flag_; }
+    void await_resume() const noexcept {}
+};
 
-private:
-    auto register_handler(EPollFdHandle &hdl, uint32_t events)
-    {
-        // link to intrusive
-        hdl.next_ =  fd_handlers_list_.next_;
-        hdl.prev_ = &fd_handlers_list_;
-        fd_handlers_list_.next_ = &hdl;
+template <typename T>
+using WhenAnyResult = std::conditional_t<std::is_void_v<T>, size_t, std::pair<size_t, T>>;
 
-        return detail::EPollEvent(*this, hdl, events);
-    }
-};
+} // namespace detail
 
-namespace detail
+/// Run @p tasks concurrently, complete when all of them do
+/// @return results in order, std::monostate for void tasks. Rethrows the first exception by order
+template <typename... Ts>
+Task<std::tuple<detail::NonVoid<Ts>...>> when_all(Task<Ts>... tasks)
 {
+    std::tuple<detail::WhenSlot<Ts>...> slots;
+    detail::WhenLatch latch{sizeof...(Ts) + 1};
+    co_await [&]<size_t... kIs>(std::index_sequence<kIs...>)
+    {
+        return detail::WhenAwaiter<sizeof...(Ts)>{latch, {detail::when_runner(std::move(tasks), std::get<kIs>(slots))...}};
+    }(std::index_sequence_for<Ts...>{});
+    co_return std::apply([](auto &...slot) { return std::tuple<detail::NonVoid<Ts>...>{slot.get()...}; }, slots);
+}
 
-EPollEvent::EPollEvent(EPoller &poller, EPollFdHandle &fd_hdl, uint32_t events)
-    : poller_{&poller}
-    , fd_handle_{&fd_hdl}
-    , enabled_types_{events}
+/// Run @p tasks concurrently, complete with the first one to finish. The rest are destroyed,
+/// i.e. cancelled, when the await completes, so they MUST run on the awaiting thread: a handle
+/// wait or timer of a dropped task is released, a submitted io_uring read is cancelled and waited
+/// for. A task suspended in schedule_on() MUST not be dropped, the posted task outlives it
+/// @return index of the first task, paired with its result for non void tasks
+template <typename T, typename... Ts>
+    requires (std::same_as<T, Ts> && ...)
+Task<detail::WhenAnyResult<T>> when_any(Task<T> first, Task<Ts>... rest)
 {
-    epoll_event event;
-    event.data.ptr = fd_handle_;
-    event.events   = events;
+    constexpr size_t kN = 1 + sizeof...(Ts);
+    std::array<detail::WhenSlot<T>, kN> slots;
+    detail::WhenLatch latch{2, true};
+    co_await [&]<size_t... kIs>(std::index_sequence<kIs...>)
+    {
+        return detail::WhenAwaiter<kN>{latch, {detail::when_runner(std::move(first), slots[0]),
+                                               detail::when_runner(std::move(rest), slots[kIs + 1])...}};
+    }(std::index_sequence_for<Ts...>{});
 
-    if (::epoll_ctl(poller_->epoll_fd_, EPOLL_CTL_ADD, fd_handle_->fd_, &event) < 0)
+    const size_t winner = latch.winner.load(std::memory_order_acquire);
+    if constexpr (std::is_void_v<T>)
     {
-        // TODO: process
-        std::abort();
+        slots[winner].get();
+        co_return winner;
+    }
+    else
+    {
+        co_return std::pair<size_t, T>{winner, slots[winner].get()};
     }
 }
 
-EPollEvent::~EPollEvent()
+namespace detail
 {
-    // if empty event
-    if (!poller_) [[unlikely]]
-        return;
-
-    ::epoll_ctl(poller_->epoll_fd_, EPOLL_CTL_DEL, fd_handle_->fd_, NULL);
-}
 
-void EPollEvent::modify(uint32_t events)
+/// Offset of the first @p delim in @p size bytes at @p data, @p size if there is none
+inline size_t find_byte(const char *data, size_t size, char delim) noexcept
 {
-    epoll_event event;
-    event.data.ptr = &fd_handle_;
-    event.events   = events;
-    if (::epoll_ctl(poller_->epoll_fd_, EPOLL_CTL_ADD, fd_handle_->fd_, &event) < 0)
+    size_t i = 0;
+#ifdef __AVX2__
+    const __m256i delim32 = _mm256_set1_epi8(delim);
+    for (; i + sizeof(__m256i) <= size; i += sizeof(__m256i))
     {
-        // TODO: process
-        std::abort();
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        if (uint32_t m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, delim32)))
+            return i + std::countr_zero(m);
+    }
+#endif
+    const __m128i delim16 = _mm_set1_epi8(delim);
+    for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i))
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (uint32_t m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, delim16)))
+            return i + std::countr_zero(m);
+    }
+    for (; i < size; ++i)
+    {
+        if (data[i] == delim)
+            return i;
     }
+    return size;
 }
 
 } // namespace detail
 
-EPollFdHandle::EPollFdHandle(int fd, EPoller &poller, uint32_t events)
-    : event_{poller.register_handler(*this, events)}
-    , fd_{fd}
+/// @brief Buffered reader of an EPollFdHandle splitting the stream into delimited records,
+/// lines, fixed size blocks and length prefixed frames
+/// @details Every wakeup drains the fd till EAGAIN or a full buffer. Records are returned as
+/// views into the buffer valid till the next read call, delimiters are searched with SIMD
+/// and bytes searched once aren't searched again while more data comes. The unread tail is
+/// moved to the buffer start only when a record doesn't fit behind it, the buffer grows up to
+/// @p max_size, a longer record fails with EMSGSIZE. A failed read returns nothing, unlike an
+/// empty record, see eof() and error(), a stopped poller leaves both unset
+class AsyncBufferedReader
 {
-    printf("EPollFdHandle() prev_ = %p, next_ = %p\n", prev_, next_);
-}
+    using Allocator = posix::AlignedAllocator<char, 64>;
 
-void EPoller::poll()
-{
-    constexpr int kMaxEvents = 1'024;
-    epoll_event events[kMaxEvents];
-    int n = ::epoll_wait(epoll_fd_, events, kMaxEvents, -1);
-    if (n < 0) [[unlikely]]
+    EPollFdHandle &hdl_;
+    char          *buf_;
+    size_t         capacity_;
+    size_t         max_size_;
+    size_t         begin_{};    // unread bytes are [begin_, end_)
+    size_t         end_{};
+    size_t         taken_{};    // size of the last returned record, consumed by the next call
+    size_t         scanned_{};  // unread bytes without the delimiter
+    int            error_{};
+    bool           eof_{};
+
+public:
+    explicit AsyncBufferedReader(EPollFdHandle &hdl, size_t max_size = size_t(1) << 20,
+                                 size_t capacity = size_t(1) << 14)
+        : hdl_{hdl}
+        , buf_{Allocator().allocate(std::min(capacity, max_size))}
+        , capacity_{std::min(capacity, max_size)}
+        , max_size_{max_size}
+    {}
+
+    ~AsyncBufferedReader() { Allocator().deallocate(buf_, capacity_); }
+
+    AsyncBufferedReader(const AsyncBufferedReader & )             = delete;
+    AsyncBufferedReader & operator=(const AsyncBufferedReader & ) = delete;
+
+    bool eof()   const noexcept { return eof_ && begin_ + taken_ == end_; }
+    int  error() const noexcept { return error_; }
+
+    /// Read but not returned bytes
+    std::span<const char> buffered() const noexcept
     {
-        // TODO: process errors
-        if (errno != EINTR)
-            std::abort();
+        return {buf_ + begin_ + taken_, end_ - begin_ - taken_};
     }
-    // process events
-    for (size_t i = 0; i < n; ++i)
+
+    /// Record up to and including @p delim, the last one may come without it at the end of file
+    Task<std::optional<std::span<const char>>> read_until(char delim)
     {
-        auto &event = events[i];
-        if (event.data.u64 == kStopFlag) [[unlikely]]
+        consume_();
+        for (;;)
         {
-            printf("Got stop\n");
-            // notify all to stop
-            stop_flag_ = true;
-            for (auto *hdl = fd_handlers_list_.next_; hdl; hdl = hdl->next_)
-                hdl->force_resume();
-            return;
+            const size_t unread = end_ - begin_;
+            size_t pos = scanned_ + detail::find_byte(buf_ + begin_ + scanned_, unread - scanned_, delim);
+            if (pos < unread)
+                co_return take_(pos + 1);
+            scanned_ = unread;
+            // not `if (!co_await ...)`, GCC 12 builds a coroutine never starting from it in a loop
+            if (const bool filled = co_await fill_(unread + 1); !filled)
+            {
+                if (eof_ && !error_ && unread)
+                    co_return take_(unread);
+                co_return std::nullopt;
+            }
         }
-        // TODO: process error events
-        auto &fd_handle = *reinterpret_cast<EPollFdHandle*>(event.data.ptr);
-        fd_handle.try_resume(event.events);
     }
-}
 
+    /// Line without its '\n'
+    Task<std::optional<std::span<const char>>> read_line()
+    {
+        auto line = co_await read_until('\n');
+        if (line && line->back() == '\n')
+            line = line->first(line->size() - 1);
+        co_return line;
+    }
+
+    /// Exactly @p size bytes, fails on the end of file before them
+    Task<std::optional<std::span<const char>>> read_exact(size_t size)
+    {
+        consume_();
+        while (end_ - begin_ < size)
+        {
+            if (const bool filled = co_await fill_(size); !filled)
+                co_return std::nullopt;
+        }
+        co_return take_(size);
+    }
+
+    /// Payload of a frame prefixed with its length, a big endian @p TLength, may be empty
+    template <std::unsigned_integral TLength = uint32_t>
+    Task<std::optional<std::span<const char>>> read_frame()
+    {
+        auto header = co_await read_exact(sizeof(TLength));
+        if (!header)
+            co_return std::nullopt;
+        uint64_t length = 0;
+        for (unsigned char c : *header)
+            length = length << 8 | c;
+        co_return co_await read_exact(length);
+    }
+
+private:
+    void consume_() noexcept
+    {
+        begin_ += std::exchange(taken_, 0);
+        if (begin_ == end_)
+            begin_ = end_ = 0;
+    }
+
+    std::span<const char> take_(size_t size) noexcept
+    {
+        taken_   = size;
+        scanned_ = 0;
+        return {buf_ + begin_, size};
+    }
+
+    // room for @p size unread bytes
+    bool reserve_(size_t size)
+    {
+        if (size > max_size_)
+        {
+            error_ = EMSGSIZE;
+            return false;
+        }
+        if (begin_ + size <= capacity_)
+            return true;
+        const size_t unread = end_ - begin_;
+        if (size <= capacity_)
+        {
+            std::memmove(buf_, buf_ + begin_, unread);
+        }
+        else
+        {
+            size_t capacity = std::min(std::max(capacity_ * 2, size), max_size_);
+            char  *buf      = Allocator().allocate(capacity);
+            std::memcpy(buf, buf_ + begin_, unread);
+            Allocator().deallocate(buf_, capacity_);
+            buf_      = buf;
+            capacity_ = capacity;
+        }
+        begin_ = 0;
+        end_   = unread;
+        return true;
+    }
+
+    // wait for more data to have at least @p size unread bytes room, then drain the fd
+    Task<bool> fill_(size_t size)
+    {
+        if (eof_ || error_ || !reserve_(size))
+            co_return false;
+        const size_t end = end_;
+        auto res = co_await hdl_.read_some_async(buf_ + end_, capacity_ - end_);
+        for (;;)
+        {
+            if (res.empty())
+            {
+                eof_   |= res.data() != nullptr;
+                error_  = hdl_.error();
+                break;
+            }
+            end_ += res.size();
+            if (end_ == capacity_)
+                break;
+            res = hdl_.try_read_some(buf_ + end_, capacity_ - end_);
+        }
+        co_return end_ > end;
+    }
+};
+
+/// @brief Eagerly started coroutine owned by the caller, the root of a chain of tasks
+/// @details The frame stays after completion and is destroyed with the object, so the owner
+/// may also cancel a suspended coroutine by destroying it
 class EPollCoroutine
 {
 public:
-    struct promise_type
+    struct promise_type : detail::PooledPromise
     {
         void                unhandled_exception() noexcept {}
         EPollCoroutine      get_return_object()            { return EPollCoroutine(*this); }
         std::suspend_never  initial_suspend()     noexcept { return {}; }
-        std::suspend_never  final_suspend()       noexcept { return {}; } // TODO: never?
+        std::suspend_always final_suspend()       noexcept { return {}; }
         void                return_void()         noexcept {}
     };
 
@@ -293,14 +2814,22 @@ private:
     {}
 
 public:
+    EPollCoroutine(EPollCoroutine &&other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+    EPollCoroutine & operator=(EPollCoroutine && ) = delete;
+
     ~EPollCoroutine()
     {
         if (handle_) handle_.destroy();
     }
+
+    bool done() const noexcept { return handle_.done(); }
 };
 
 } // namespace hmbl::async
 
+// a demo, left out by the benchmarks which include this file
+#ifndef HMBL_EPOLLER_NO_DEMO
+
 hmbl::async::EPollCoroutine test_coro(hmbl::async::EPoller &poller, int fd)
 {
     hmbl::async::EPollFdHandle hdl(fd, poller, EPOLLIN);
@@ -346,9 +2875,6 @@ int main()
     ::fsync(fds[1]);
     printf("Write OK\n");
 
-    poller.poll();
-    poller.poll();
-
     // if (::write(fds[1], "Hello World!", 12) < 0)
     // {
     //     // TODO
@@ -356,8 +2882,11 @@ int main()
     // }
     auto res = std::async(std::launch::async,
         [&]() { std::this_thread::sleep_for(std::chrono::seconds(3)); poller.stop(); });
-    poller.poll();
+    while (!poller.is_stopped()) // a round may read both chunks or one of them
+        poller.poll();
     // poller.stop();
 
     return 0;
-}
\ No newline at end of file
+}
+
+#endif // HMBL_EPOLLER_NO_DEMO
\ No newline at end of file
@@ -0,0 +1,400 @@
+// Benchmarks of the EPoller reactor over socketpairs and pipes:
+//  - round trip latency percentiles of a ping-pong with an echo thread
+//  - messages per second from N producer threads into one reactor
+//  - registration, ping-pong latency and stop broadcast with 1k..100k idle fds registered
+// Syscalls of the reactor thread are counted by the raw_syscalls:sys_enter tracepoint if
+// perf_event_open(2) allows it, reactor waits come from the poller metrics in any case
+//
+//   g++ -std=c++20 -O2 -march=native -Iinclude src/linux/epoller_bench.cpp -o epoller_bench -pthread
+//   epoller_bench [epoll|uring] [round trips]
+
+#define HMBL_EPOLLER_NO_DEMO
+#include "epoller.cpp"
+
+#include <csignal>
+#include <fstream>
+#include <string_view>
+
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+
+namespace
+{
+
+using namespace hmbl::async;
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kMessageSize = 64;
+
+/// Syscalls entered by the calling thread, nothing if the tracepoint isn't accessible
+class SyscallCounter
+{
+    int fd_{-1};
+
+public:
+    SyscallCounter()
+    {
+        for (const char *path : {"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                                 "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"})
+        {
+            std::ifstream in(path);
+            uint64_t id;
+            if (!(in >> id))
+                continue;
+            perf_event_attr attr{};
+            attr.type   = PERF_TYPE_TRACEPOINT;
+            attr.size   = sizeof(attr);
+            attr.config = id;
+            fd_ = ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+            if (fd_ >= 0)
+                break;
+        }
+    }
+
+    ~SyscallCounter()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    SyscallCounter(const SyscallCounter & )             = delete;
+    SyscallCounter & operator=(const SyscallCounter & ) = delete;
+
+    bool enabled() const noexcept { return fd_ >= 0; }
+
+    std::optional<uint64_t> read() const noexcept
+    {
+        uint64_t cnt;
+        if (fd_ < 0 || ::read(fd_, &cnt, sizeof(cnt)) != sizeof(cnt))
+            return std::nullopt;
+        return cnt;
+    }
+};
+
+/// Reactor thread counters at a point in time
+struct Sample
+{
+    std::optional<uint64_t> syscalls;
+    size_t                  waits;
+    Clock::time_point       time;
+
+    static Sample take(const EPoller &poller, const SyscallCounter &counter)
+    {
+        return {counter.read(), poller.metrics() ? poller.metrics()->waits : 0, Clock::now()};
+    }
+};
+
+void print_cost(const Sample &begin, const Sample &end, size_t messages)
+{
+    messages = std::max<size_t>(messages, 1);
+    if (begin.syscalls && end.syscalls)
+        printf(" syscalls/msg %.2f", double(*end.syscalls - *begin.syscalls) / messages);
+    else
+        printf(" syscalls/msg n/a");
+    printf(" waits/msg %.2f\n", double(end.waits - begin.waits) / messages);
+}
+
+void print_latency(std::vector<uint64_t> &rtt)
+{
+    if (rtt.empty())
+    {
+        printf(" no round trips");
+        return;
+    }
+    std::sort(rtt.begin(), rtt.end());
+    auto at = [&](double q) { return rtt[std::min(rtt.size() - 1, size_t(q * rtt.size()))] / 1e3; };
+    printf(" rtt us p50 %.2f p90 %.2f p99 %.2f p99.9 %.2f max %.2f", at(0.5), at(0.9), at(0.99), at(0.999),
+           rtt.back() / 1e3);
+}
+
+enum class Transport : uint8_t
+{
+    kSocketPair,
+    kPipe,
+};
+
+const char * name(Transport transport)
+{
+    return transport == Transport::kSocketPair ? "socketpair" : "pipe";
+}
+
+/// Both directions between the reactor and a peer thread, a socketpair uses one fd per side
+struct Channel
+{
+    int reactor_rd;
+    int reactor_wr;
+    int peer_rd;
+    int peer_wr;
+
+    explicit Channel(Transport transport)
+    {
+        int a[2], b[2];
+        if (transport == Transport::kSocketPair)
+        {
+            if (::socketpair(AF_UNIX, SOCK_STREAM, 0, a) != 0)
+                std::abort();
+            reactor_rd = reactor_wr = a[0];
+            peer_rd    = peer_wr    = a[1];
+            return;
+        }
+        if (::pipe(a) != 0 || ::pipe(b) != 0)
+            std::abort();
+        reactor_wr = a[1];
+        peer_rd    = a[0];
+        peer_wr    = b[1];
+        reactor_rd = b[0];
+    }
+
+    void close_reactor() const
+    {
+        ::close(reactor_rd);
+        if (reactor_wr != reactor_rd)
+            ::close(reactor_wr);
+    }
+
+    void close_peer() const
+    {
+        ::close(peer_rd);
+        if (peer_wr != peer_rd)
+            ::close(peer_wr);
+    }
+};
+
+/// Echo fixed size messages back till the end of file
+void echo(int rd, int wr)
+{
+    char buf[kMessageSize];
+    for (;;)
+    {
+        size_t got = 0;
+        while (got < sizeof(buf))
+        {
+            auto n = ::read(rd, buf + got, sizeof(buf) - got);
+            if (n <= 0)
+                return;
+            got += n;
+        }
+        if (::write(wr, buf, sizeof(buf)) != ssize_t(sizeof(buf)))
+            return;
+    }
+}
+
+EPollCoroutine ping(EPollFdHandle &rd, EPollFdHandle &wr, size_t n, std::vector<uint64_t> &rtt)
+{
+    char msg[kMessageSize]{};
+    char buf[kMessageSize];
+    for (size_t i = 0; i < n; ++i)
+    {
+        const auto start = Clock::now();
+        auto written = co_await wr.write_all_async(msg, sizeof(msg));
+        if (written.size() != sizeof(msg))
+            co_return;
+        for (size_t got = 0; got < sizeof(buf);)
+        {
+            auto res = co_await rd.read_some_async(buf + got, sizeof(buf) - got);
+            if (res.empty())
+                co_return;
+            got += res.size();
+        }
+        rtt.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+}
+
+void ping_pong(EPoller &poller, const SyscallCounter &counter, Transport transport, size_t n)
+{
+    Channel ch(transport);
+    std::thread peer(echo, ch.peer_rd, ch.peer_wr);
+    std::vector<uint64_t> rtt;
+    rtt.reserve(n);
+    Sample begin, end;
+    {
+        auto rd = std::make_unique<EPollFdHandle>(ch.reactor_rd, poller, EPOLLIN);
+        std::unique_ptr<EPollFdHandle> wr;
+        if (ch.reactor_wr != ch.reactor_rd)
+            wr = std::make_unique<EPollFdHandle>(ch.reactor_wr, poller, EPOLLOUT);
+
+        begin = Sample::take(poller, counter);
+        auto coro = ping(*rd, wr ? *wr : *rd, n, rtt);
+        while (!coro.done())
+            poller.poll();
+        end = Sample::take(poller, counter);
+    }
+    // handles first, io_uring keeps a registered file open till then
+    ch.close_reactor();
+    peer.join();
+    ch.close_peer();
+
+    printf("ping-pong %-10s", name(transport));
+    print_latency(rtt);
+    print_cost(begin, end, 2 * rtt.size());
+}
+
+/// Write @p n messages, one syscall each, and close
+void produce(int wr, size_t n)
+{
+    char msg[kMessageSize]{};
+    for (size_t i = 0; i < n; ++i)
+        if (::write(wr, msg, sizeof(msg)) != ssize_t(sizeof(msg)))
+            break;
+    ::close(wr);
+}
+
+EPollCoroutine consume(EPollFdHandle &rd, size_t &bytes)
+{
+    std::vector<char> buf(1 << 14);
+    for (;;)
+    {
+        auto res = co_await rd.read_some_async(buf.data(), buf.size());
+        if (res.empty())
+            co_return;
+        bytes += res.size();
+    }
+}
+
+void fan_in(EPoller::Backend backend, const SyscallCounter &counter, Transport transport, size_t producers,
+            size_t n)
+{
+    EPoller poller(backend);
+    poller.enable_metrics();
+
+    std::vector<Channel> channels;
+    std::vector<std::unique_ptr<EPollFdHandle>> handles;
+    std::vector<EPollCoroutine> consumers;
+    std::vector<size_t> bytes(producers);
+    for (size_t i = 0; i < producers; ++i)
+    {
+        channels.emplace_back(transport);
+        if (transport == Transport::kSocketPair)
+            ::shutdown(channels.back().reactor_rd, SHUT_WR);
+        handles.push_back(std::make_unique<EPollFdHandle>(channels.back().reactor_rd, poller, EPOLLIN));
+        consumers.push_back(consume(*handles.back(), bytes[i]));
+    }
+
+    const auto begin = Sample::take(poller, counter);
+    std::vector<std::thread> threads;
+    for (auto &ch : channels)
+        threads.emplace_back(produce, ch.peer_wr, n);
+    for (auto &coro : consumers)
+        while (!coro.done())
+            poller.poll();
+    const auto end = Sample::take(poller, counter);
+
+    for (auto &t : threads)
+        t.join();
+    consumers.clear();
+    handles.clear();
+    for (auto &ch : channels)
+    {
+        ch.close_reactor();
+        if (ch.peer_rd != ch.peer_wr) // the producer closed its end
+            ::close(ch.peer_rd);
+    }
+
+    size_t messages{};
+    for (auto b : bytes)
+        messages += b / kMessageSize;
+    const double secs = std::chrono::duration<double>(end.time - begin.time).count();
+    printf("fan-in    %-10s producers %-3zu msgs/s %.0f", name(transport), producers, messages / secs);
+    print_cost(begin, end, messages);
+}
+
+EPollCoroutine idle(EPollFdHandle &hdl, ReadBufferPool &pool)
+{
+    auto res = co_await hdl.read_pooled_async(pool);
+    (void)res;
+}
+
+void scaling(EPoller::Backend backend, const SyscallCounter &counter, size_t fds, size_t n)
+{
+    rlimit limit{};
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    if (fds + 64 > limit.rlim_cur)
+    {
+        printf("idle fds  %-7zu skipped, RLIMIT_NOFILE is %zu\n", fds, size_t(limit.rlim_cur));
+        return;
+    }
+
+    EPoller poller(backend);
+    poller.enable_metrics();
+    ReadBufferPool pool;
+
+    std::vector<int> event_fds(fds);
+    std::vector<std::unique_ptr<EPollFdHandle>> handles;
+    std::vector<EPollCoroutine> waiters;
+    handles.reserve(fds);
+    waiters.reserve(fds);
+
+    // an idle waiter registers its fd on the first wait
+    const auto reg_start = Clock::now();
+    for (auto &fd : event_fds)
+    {
+        fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0)
+            std::abort();
+        handles.push_back(std::make_unique<EPollFdHandle>(fd, poller, EPOLLIN));
+        waiters.push_back(idle(*handles.back(), pool));
+    }
+    const double reg_ns = std::chrono::duration<double, std::nano>(Clock::now() - reg_start).count();
+    printf("idle fds  %-7zu register ns/fd %.0f pooled buffers %zu\n", fds, reg_ns / fds, pool.capacity());
+
+    printf("  with idle ");
+    ping_pong(poller, counter, Transport::kSocketPair, n);
+
+    // stop() walks the intrusive handle list and resumes every waiter
+    const auto stop_start = Clock::now();
+    poller.stop();
+    while (!poller.is_stopped())
+        poller.poll();
+    const double stop_ns = std::chrono::duration<double, std::nano>(Clock::now() - stop_start).count();
+    size_t stopped{};
+    for (auto &w : waiters)
+        stopped += w.done();
+    printf("  stop broadcast us %.0f ns/handle %.1f resumed %zu\n", stop_ns / 1e3, stop_ns / fds, stopped);
+
+    waiters.clear();
+    handles.clear();
+    for (auto fd : event_fds)
+        ::close(fd);
+}
+
+void raise_fd_limit()
+{
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const auto backend = argc > 1 && std::string_view(argv[1]) == "epoll" ? EPoller::Backend::kEPoll
+                                                                          : EPoller::Backend::kIOURing;
+    const size_t n = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100'000;
+
+    raise_fd_limit();
+    ::signal(SIGPIPE, SIG_IGN);
+    SyscallCounter counter;
+
+    {
+        EPoller poller(backend);
+        poller.enable_metrics();
+        printf("backend %s, syscall counting %s, %zu round trips, %zu byte messages\n",
+               poller.backend() == EPoller::Backend::kIOURing ? "io_uring" : "epoll",
+               counter.enabled() ? "on" : "off (no tracepoint access)", n, kMessageSize);
+        for (auto transport : {Transport::kSocketPair, Transport::kPipe})
+            ping_pong(poller, counter, transport, n);
+    }
+
+    for (auto transport : {Transport::kSocketPair, Transport::kPipe})
+        for (size_t producers : {1, 4, 16})
+            fan_in(backend, counter, transport, producers, 10 * n / producers);
+
+    for (size_t fds : {1'000, 10'000, 100'000})
+        scaling(backend, counter, fds, n / 10);
+
+    return 0;
+}
@@ -0,0 +1,533 @@
+// Tests of the EPoller reactor on both backends
+//
+//   g++ -std=c++20 -O2 -Iinclude test/epoller_test.cpp -o epoller_test -pthread
+
+#define HMBL_EPOLLER_NO_DEMO
+#include "../src/linux/epoller.cpp"
+
+#include <csignal>
+#include <stdexcept>
+#include <string_view>
+
+using namespace hmbl::async;
+
+namespace
+{
+
+Task<int> read_some(EPollFdHandle &hdl, char *buf, size_t size, std::chrono::milliseconds timeout = kNoTimeout)
+{
+    auto res = co_await hdl.read_some_async(buf, size, timeout);
+    co_return static_cast<int>(res.size());
+}
+
+Task<int> write_all(EPollFdHandle &hdl, const char *buf, size_t size)
+{
+    auto res = co_await hdl.write_all_async(buf, size);
+    co_return static_cast<int>(res.size());
+}
+
+Task<int> sleep(EPoller &poller, int ms)
+{
+    co_await poller.sleep_for(std::chrono::milliseconds(ms));
+    co_return -1;
+}
+
+template <typename T>
+struct Result
+{
+    std::optional<T> value;
+};
+
+template <typename T>
+EPollCoroutine run(Task<T> task, Result<T> &res)
+{
+    res.value.emplace(co_await task);
+}
+
+template <typename T>
+T run_until_done(EPoller &poller, Task<T> task)
+{
+    Result<T> res;
+    auto coro = run(std::move(task), res);
+    while (!coro.done())
+        poller.poll();
+    return std::move(*res.value);
+}
+
+Task<size_t> depth(EPoller &poller, size_t n)
+{
+    if (!n)
+    {
+        co_await poller.sleep_for(std::chrono::milliseconds(1)); // the chain completes from the loop
+        co_return 0;
+    }
+    co_return 1 + co_await depth(poller, n - 1);
+}
+
+Task<int> value(EPoller &poller, int ms, int res)
+{
+    co_await poller.sleep_for(std::chrono::milliseconds(ms));
+    co_return res;
+}
+
+Task<void> fail(EPoller &poller, int ms)
+{
+    co_await poller.sleep_for(std::chrono::milliseconds(ms));
+    throw std::runtime_error("fail");
+}
+
+Task<int> all_or_error(EPoller &poller, int fail_ms)
+{
+    try
+    {
+        auto [res, none] = co_await when_all(value(poller, 1, 7), fail(poller, fail_ms));
+        (void)none;
+        co_return res;
+    }
+    catch (const std::runtime_error &)
+    {
+        co_return -1;
+    }
+}
+
+// results travel up deep await chains and out of when_all/when_any
+void test_tasks(EPoller::Backend backend)
+{
+    EPoller poller(backend);
+#ifdef __SANITIZE_ADDRESS__
+    constexpr size_t kDepth = 1'000; // instrumented frames break the tail calls of symmetric transfer
+#else
+    constexpr size_t kDepth = 100'000;
+#endif
+    assert(run_until_done(poller, depth(poller, kDepth)) == kDepth);
+
+    auto [a, b] = run_until_done(poller, when_all(value(poller, 5, 1), value(poller, 1, 2)));
+    assert(a == 1 && b == 2);
+    // the exception comes when all are done, whether the failing task finishes first or last
+    assert(run_until_done(poller, all_or_error(poller, 0)) == -1);
+    assert(run_until_done(poller, all_or_error(poller, 5)) == -1);
+
+    auto [winner, res] = run_until_done(poller, when_any(value(poller, 50, 1), value(poller, 1, 2), value(poller, 20, 3)));
+    assert(winner == 1 && res == 2);
+    // the first ready one wins, the later ones are dropped without ever running
+    auto [first, first_res] = run_until_done(poller, when_any(value(poller, 0, 4), value(poller, 0, 5)));
+    assert(first == 0 && first_res == 4);
+}
+
+// a read or write dropped by when_any leaves no waiter behind to resume its freed frame
+void test_when_any_drops_io(EPoller::Backend backend)
+{
+    EPoller poller(backend);
+    int fds[2];
+    assert(::pipe(fds) == 0);
+    {
+        EPollFdHandle reader(fds[0], poller, EPOLLIN);
+        EPollFdHandle writer(fds[1], poller, EPOLLOUT);
+
+        char buf[16];
+        auto [winner, value] = run_until_done(poller, when_any(read_some(reader, buf, sizeof(buf)), sleep(poller, 1)));
+        assert(winner == 1 && value == -1);
+
+        // the readiness or completion of the dropped read resumes nothing, a new read gets the data
+        assert(::write(fds[1], "ping", 4) == 4);
+        run_until_done(poller, sleep(poller, 5));
+        assert(run_until_done(poller, read_some(reader, buf, sizeof(buf))) == 4 && !std::memcmp(buf, "ping", 4));
+
+        // a writer suspended on a full pipe
+        std::vector<char> fill(1 << 20, 'x');
+        while (!writer.try_write_some(fill.data(), fill.size()).empty())
+            ;
+        auto [wwinner, wvalue] = run_until_done(poller, when_any(write_all(writer, fill.data(), 1), sleep(poller, 1)));
+        assert(wwinner == 1 && wvalue == -1);
+        while (!reader.try_read_some(fill.data(), fill.size()).empty())
+            ;
+        run_until_done(poller, sleep(poller, 5));
+        assert(run_until_done(poller, write_all(writer, "pong", 4)) == 4);
+        assert(run_until_done(poller, read_some(reader, buf, sizeof(buf))) == 4 && !std::memcmp(buf, "pong", 4));
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+// bytes in the peer's receive queue, read without blocking
+size_t drain(int fd)
+{
+    size_t res = 0;
+    char   buf[1 << 16];
+    for (ssize_t n; (n = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0;)
+        res += n;
+    return res;
+}
+
+// a read and a write of one socket in when_any, the winner drops the other one, which neither
+// runs nor touches the socket after, also when both are resumed by one event or by stop
+void test_when_any_duplex(EPoller::Backend backend)
+{
+    for (bool stop : {false, true})
+    {
+        EPoller poller(backend);
+        int fds[2];
+        assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        {
+            EPollFdHandle hdl(fds[0], poller, EPOLLIN | EPOLLOUT);
+            std::vector<char> fill(1 << 20, 'x');
+            size_t filled = 0;
+            for (std::span<const char> res; !(res = hdl.try_write_some(fill.data(), fill.size())).empty();)
+                filled += res.size();
+
+            char buf[16];
+            Result<std::pair<size_t, int>> res;
+            auto coro = run(when_any(read_some(hdl, buf, sizeof(buf)), write_all(hdl, "late", 4)), res);
+            assert(!coro.done());
+            if (stop)
+            {
+                poller.stop();
+            }
+            else
+            {
+                // readable and writable before the next poll, a single epoll event reports both
+                assert(::write(fds[1], "ping", 4) == 4);
+                assert(drain(fds[1]) == filled);
+            }
+            while (!coro.done())
+                poller.poll();
+
+            auto [winner, value] = *res.value;
+            if (stop)
+                assert(value == 0 && drain(fds[1]) == filled);
+            else if (winner == 0)
+                assert(value == 4 && !std::memcmp(buf, "ping", 4) && drain(fds[1]) == 0);
+            else
+                assert(value == 4 && drain(fds[1]) == 4);
+        }
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+}
+
+Task<int> hop(EPoller &poller)
+{
+    co_await schedule_on(poller);
+    co_return 1;
+}
+
+// expiring timers and schedule_on() resume through the timed path like handle events
+void test_metrics_resumes(EPoller::Backend backend)
+{
+    EPoller poller(backend);
+    poller.enable_metrics();
+    assert(run_until_done(poller, sleep(poller, 1)) == -1);
+    assert(poller.metrics()->resumes == 1 && poller.metrics()->slowest_frame);
+    assert(run_until_done(poller, hop(poller)) == 1);
+    assert(poller.metrics()->resumes == 2);
+}
+
+EPollCoroutine owned_read(EPoller &poller, int fd, bool &resumed)
+{
+    EPollFdHandle hdl(fd, poller, EPOLLIN);
+    char buf[16];
+    co_await hdl.read_some_async(buf, sizeof(buf));
+    resumed = true;
+}
+
+// reads submitted to the ring: into registered buffers, with linked timeouts, cancelled by stop
+// and by destroying the reading coroutine along with its handle
+void test_uring_reads()
+{
+    EPoller poller(EPoller::Backend::kIOURing);
+    if (poller.backend() != EPoller::Backend::kIOURing)
+        return; // the kernel lacks io_uring
+    assert(!EPoller(EPoller::Backend::kEPoll).register_buffers({}));
+
+    int fds[2];
+    assert(::pipe(fds) == 0);
+    {
+        EPollFdHandle hdl(fds[0], poller, EPOLLIN);
+        char buf[16];
+
+        // READ_FIXED into a registered buffer or a part of it, a plain READ into others
+        alignas(64) char fixed[256];
+        const iovec iov{fixed, sizeof(fixed)};
+        assert(poller.register_buffers(std::span(&iov, 1)));
+        assert(::write(fds[1], "fixed", 5) == 5);
+        assert(run_until_done(poller, read_some(hdl, fixed + 8, 64)) == 5 && !std::memcmp(fixed + 8, "fixed", 5));
+        assert(::write(fds[1], "plain", 5) == 5);
+        assert(run_until_done(poller, read_some(hdl, buf, sizeof(buf))) == 5 && !std::memcmp(buf, "plain", 5));
+        assert(poller.register_buffers({})); // replaced by none
+
+        // the linked timeout cancels the read
+        assert(run_until_done(poller, read_some(hdl, buf, sizeof(buf), std::chrono::milliseconds(5))) == 0);
+        assert(hdl.error() == ETIMEDOUT);
+        assert(::write(fds[1], "in time", 7) == 7);
+        assert(run_until_done(poller, read_some(hdl, buf, sizeof(buf), std::chrono::milliseconds(1'000))) == 7);
+        assert(!hdl.error());
+    }
+    {
+        // the submitted read of a destroyed coroutine is cancelled and waited for with its handle
+        bool resumed = false;
+        {
+            auto coro = owned_read(poller, fds[0], resumed);
+            run_until_done(poller, sleep(poller, 1)); // submits the read
+            assert(!coro.done());
+        }
+        assert(::write(fds[1], "later", 5) == 5);
+        run_until_done(poller, sleep(poller, 5));
+        assert(!resumed);
+
+        EPollFdHandle hdl(fds[0], poller, EPOLLIN);
+        char buf[16];
+        assert(run_until_done(poller, read_some(hdl, buf, sizeof(buf))) == 5 && !std::memcmp(buf, "later", 5));
+
+        // stop cancels the submitted read
+        Result<int> res;
+        auto coro = run(read_some(hdl, buf, sizeof(buf)), res);
+        run_until_done(poller, sleep(poller, 1));
+        poller.stop();
+        while (!coro.done())
+            poller.poll();
+        assert(*res.value == 0 && hdl.error() == ECANCELED);
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+template <bool kTee>
+Task<size_t> transfer(EPollFdHandle &src, EPollFdHandle &dst, size_t len, std::chrono::milliseconds timeout = kNoTimeout)
+{
+    if constexpr (kTee)
+        co_return co_await tee_async(src, dst, len, timeout);
+    else
+        co_return co_await splice_async(src, dst, len, timeout);
+}
+
+// splice pipe to socket and pipe to pipe, tee pipe to pipe, waiting on either side or timing out
+void test_transfer(EPoller::Backend backend)
+{
+    EPoller poller(backend);
+    int in[2], out[2], sock[2];
+    assert(::pipe(in) == 0 && ::pipe(out) == 0 && ::socketpair(AF_UNIX, SOCK_STREAM, 0, sock) == 0);
+    {
+        EPollFdHandle src(in[0], poller, EPOLLIN);
+        EPollFdHandle dst(out[1], poller, EPOLLOUT);
+        EPollFdHandle peer(sock[0], poller, EPOLLOUT);
+        char buf[16];
+
+        // pipe to socket, the source becomes readable while the transfer waits
+        Result<size_t> res;
+        auto coro = run(transfer<false>(src, peer, sizeof(buf)), res);
+        assert(!coro.done());
+        assert(::write(in[1], "splice", 6) == 6);
+        while (!coro.done())
+            poller.poll();
+        assert(*res.value == 6 && ::read(sock[1], buf, sizeof(buf)) == 6 && !std::memcmp(buf, "splice", 6));
+
+        // tee leaves the data in the source
+        assert(::write(in[1], "tee", 3) == 3);
+        assert(run_until_done(poller, transfer<true>(src, dst, sizeof(buf))) == 3);
+        assert(::read(out[0], buf, sizeof(buf)) == 3 && !std::memcmp(buf, "tee", 3));
+
+        // pipe to a full pipe, the destination becomes writable while the transfer waits
+        std::vector<char> fill(1 << 20, 'x');
+        size_t filled = 0;
+        for (std::span<const char> w; !(w = dst.try_write_some(fill.data(), fill.size())).empty();)
+            filled += w.size();
+        Result<size_t> full_res;
+        auto full = run(transfer<false>(src, dst, sizeof(buf)), full_res);
+        run_until_done(poller, sleep(poller, 5)); // a readable source retries and waits on
+        assert(!full.done());
+        for (size_t n = 0; n < filled;)
+            n += ::read(out[0], fill.data(), std::min(fill.size(), filled - n));
+        while (!full.done())
+            poller.poll();
+        assert(*full_res.value == 3 && ::read(out[0], buf, sizeof(buf)) == 3 && !std::memcmp(buf, "tee", 3));
+
+        // nothing to move
+        assert(run_until_done(poller, transfer<false>(src, dst, sizeof(buf), std::chrono::milliseconds(5))) == 0);
+        assert(src.error() == ETIMEDOUT && dst.error() == ETIMEDOUT);
+        assert(run_until_done(poller, transfer<true>(src, dst, sizeof(buf), std::chrono::milliseconds(5))) == 0);
+        assert(src.error() == ETIMEDOUT && dst.error() == ETIMEDOUT);
+    }
+    for (int fd : {in[0], in[1], out[0], out[1], sock[0], sock[1]})
+        ::close(fd);
+}
+
+// callables posted by several threads run exactly once each on the polling thread, which blocks
+// between the rounds, so a wakeup lost to the coalescing flag hangs the test
+void test_post(EPoller::Backend backend)
+{
+    EPoller poller(backend);
+
+    // at most 1'024 a drain, the rest goes in the next one
+    constexpr size_t kBurst = 3'000;
+    size_t ran = 0;
+    for (size_t i = 0; i < kBurst; ++i)
+        poller.post([&ran] { ++ran; });
+    poller.poll();
+    assert(ran >= 1'024 && ran < kBurst);
+    while (ran < kBurst)
+        poller.poll();
+
+    constexpr size_t kProducers = 4;
+    constexpr size_t kPosts     = 20'000;
+    std::vector<uint8_t> runs(kProducers * kPosts);
+    size_t     total      = 0;
+    bool       off_thread = false;
+    const auto poller_thread = std::this_thread::get_id();
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < kProducers; ++t)
+    {
+        producers.emplace_back([&, t]
+        {
+            for (size_t i = t * kPosts; i < (t + 1) * kPosts; ++i)
+            {
+                poller.post([&, i]
+                {
+                    ++runs[i];
+                    ++total;
+                    off_thread |= std::this_thread::get_id() != poller_thread;
+                });
+                if (!(i % 256))
+                    std::this_thread::yield();
+            }
+        });
+    }
+    while (total < std::size(runs))
+        poller.poll();
+    for (auto &producer : producers)
+        producer.join();
+    assert(!off_thread && std::all_of(std::begin(runs), std::end(runs), [](uint8_t n) { return n == 1; }));
+}
+
+Task<PooledReadBuffer> read_pooled(EPollFdHandle &hdl, ReadBufferPool &pool)
+{
+    co_return co_await hdl.read_pooled_async(pool);
+}
+
+// a pooled read holds a buffer only from finding data till its release
+void test_read_buffer_pool(EPoller::Backend backend)
+{
+    EPoller poller(backend);
+    ReadBufferPool pool(1'000, 4);
+    assert(pool.buffer_size() == 1'024 && !pool.capacity());
+    int fds[2];
+    assert(::pipe(fds) == 0);
+    {
+        EPollFdHandle hdl(fds[0], poller, EPOLLIN);
+
+        // nothing to read, the buffer taken to try goes back at once
+        Result<PooledReadBuffer> res;
+        auto coro = run(read_pooled(hdl, pool), res);
+        assert(!coro.done() && !pool.lent() && pool.capacity() == 4);
+        assert(::write(fds[1], "pooled", 6) == 6);
+        while (!coro.done())
+            poller.poll();
+        auto &buf = *res.value;
+        assert(buf && std::string_view(buf.data(), buf.size()) == "pooled" && pool.lent() == 1);
+
+        pool.trim(); // kept while lent
+        assert(pool.capacity() == 4);
+        buf.release();
+        assert(!pool.lent() && pool.peak_lent() == 1);
+
+        // buffers held at once come from new slabs, all go back
+        std::vector<PooledReadBuffer> held;
+        for (int i = 0; i < 6; ++i)
+        {
+            assert(::write(fds[1], "x", 1) == 1);
+            held.push_back(run_until_done(poller, read_pooled(hdl, pool)));
+        }
+        assert(pool.lent() == 6 && pool.capacity() == 8);
+        held.clear();
+        assert(!pool.lent() && pool.peak_lent() == 6);
+        pool.trim();
+        assert(!pool.capacity());
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+// every poller thread of a group runs on one of the cpus allowed to the process
+void test_group_pinning()
+{
+    cpu_set_t allowed;
+    assert(!::sched_getaffinity(0, sizeof(allowed), &allowed));
+    EPollerGroup group(3);
+    group.start();
+    for (size_t i = 0; i < group.size(); ++i)
+    {
+        std::promise<cpu_set_t> pinned;
+        group[i].post([&pinned]
+        {
+            cpu_set_t cpus;
+            ::sched_getaffinity(0, sizeof(cpus), &cpus);
+            pinned.set_value(cpus);
+        });
+        cpu_set_t cpus = pinned.get_future().get();
+        cpu_set_t outside;
+        CPU_XOR(&outside, &cpus, &allowed);
+        CPU_AND(&outside, &outside, &cpus);
+        assert(CPU_COUNT(&cpus) == 1 && !CPU_COUNT(&outside));
+    }
+}
+
+Task<bool> read_records(AsyncBufferedReader &reader)
+{
+    auto empty_frame = co_await reader.read_frame();
+    if (!empty_frame || !empty_frame->empty())
+        co_return false;
+    auto frame = co_await reader.read_frame();
+    if (!frame || std::string_view(frame->data(), frame->size()) != "abc")
+        co_return false;
+    auto empty_line = co_await reader.read_line();
+    if (!empty_line || !empty_line->empty())
+        co_return false;
+    auto last = co_await reader.read_line(); // without '\n' at the end of file
+    if (!last || std::string_view(last->data(), last->size()) != "end")
+        co_return false;
+    auto none = co_await reader.read_frame();
+    co_return !none && reader.eof() && !reader.error();
+}
+
+// an empty record isn't the end of file
+void test_buffered_reader_records(EPoller::Backend backend)
+{
+    EPoller poller(backend);
+    int fds[2];
+    assert(::pipe(fds) == 0);
+    {
+        EPollFdHandle hdl(fds[0], poller, EPOLLIN);
+        AsyncBufferedReader reader(hdl);
+        const char data[] = "\0\0\0\0" "\0\0\0\3abc" "\nend";
+        assert(::write(fds[1], data, sizeof(data) - 1) == sizeof(data) - 1);
+        ::close(fds[1]);
+        assert(run_until_done(poller, read_records(reader)));
+    }
+    ::close(fds[0]);
+}
+
+}
+
+int main()
+{
+    ::signal(SIGPIPE, SIG_IGN);
+    test_tasks(EPoller::Backend::kEPoll);
+    test_tasks(EPoller::Backend::kIOURing);
+    test_when_any_drops_io(EPoller::Backend::kEPoll);
+    test_when_any_drops_io(EPoller::Backend::kIOURing);
+    test_when_any_duplex(EPoller::Backend::kEPoll);
+    test_when_any_duplex(EPoller::Backend::kIOURing);
+    test_metrics_resumes(EPoller::Backend::kEPoll);
+    test_metrics_resumes(EPoller::Backend::kIOURing);
+    test_uring_reads();
+    test_transfer(EPoller::Backend::kEPoll);
+    test_transfer(EPoller::Backend::kIOURing);
+    test_post(EPoller::Backend::kEPoll);
+    test_post(EPoller::Backend::kIOURing);
+    test_read_buffer_pool(EPoller::Backend::kEPoll);
+    test_read_buffer_pool(EPoller::Backend::kIOURing);
+    test_group_pinning();
+    test_buffered_reader_records(EPoller::Backend::kEPoll);
+    test_buffered_reader_records(EPoller::Backend::kIOURing);
+    printf("epoller tests passed\n");
+    return 0;
+}
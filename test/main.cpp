@@ -1,6 +1,14 @@
 #include "humble/bitset.hpp"
+#include "humble/bit_matrix.hpp"
+#include "humble/bitset_hash_table.hpp"
 #include "humble/sparse_dynamic_bitset.hpp"
+#include "humble/sparse_bitset_query.hpp"
+#include "humble/intersection_cache.hpp"
 #include "humble/posix/aligned_allocator.h"
+#include "humble/posix/arena_allocator.h"
+#include "humble/posix/huge_page_allocator.h"
+#include "humble/posix/numa_allocator.h"
+#include "humble/posix/stats_allocator.h"
 
 #include <iostream>
 #include <bitset>
@@ -44,6 +52,58 @@ int main()
     assert((hmbl_b1 & hmbl_b).count() == 1);
     assert((hmbl_b1 | hmbl_b).count() == 5);
 
+    hmbl::Bitset<999> hmbl_b2;
+    hmbl_b2.set(0).set(64).set(998);
+    assert((hmbl_b2 << 64).test(64) && (hmbl_b2 << 64).test(128) && (hmbl_b2 << 64).count() == 2);
+    assert((hmbl_b2 >> 64).test(0) && (hmbl_b2 >> 64).test(934) && (hmbl_b2 >> 64).count() == 2);
+    assert((hmbl_b2 >> 3).test(61) && (hmbl_b2 >> 3).test(995) && (hmbl_b2 >> 3).count() == 2);
+    assert((hmbl_b2 << 999).none());
+    assert(hmbl::Bitset<999>(hmbl_b2).shift_left<67>() == (hmbl_b2 << 67));
+    assert(hmbl::Bitset<999>(hmbl_b2).shift_right<130>() == (hmbl_b2 >> 130));
+    assert(hmbl::Bitset<999>(hmbl_b2).rotate<2>() == hmbl::Bitset<999>().set(1).set(2).set(66));
+    assert(hmbl::Bitset<999>(hmbl_b2).rotate<500>().rotate<499>() == hmbl_b2);
+
+    hmbl::BitMatrix<100, 130> bm;
+    for (size_t r = 0; r < bm.rows(); ++r)
+        for (size_t c = 0; c < bm.cols(); ++c)
+            bm.set(r, c, (r * 7 + c * 13) % 5 == 0);
+    auto bm_t = bm.transposed();
+    for (size_t r = 0; r < bm.rows(); ++r)
+        for (size_t c = 0; c < bm.cols(); ++c)
+            assert(bm.test(r, c) == bm_t.test(c, r));
+    assert(bm_t.transposed() == bm);
+    assert(bm.column(3) == bm_t.row(3));
+
+    auto bm_sq = bm.multiply(bm_t);
+    for (size_t r = 0; r < bm_sq.rows(); ++r)
+        for (size_t c = 0; c < bm_sq.cols(); ++c)
+            assert(bm_sq.test(r, c) == (bm.row(r) & bm.row(c)).any());
+
+    hmbl::BitMatrix<70, 70> graph;
+    for (size_t v = 0; v + 1 < graph.rows(); ++v)
+        graph.set(v, v + 1);
+    graph.transitive_closure();
+    assert(graph.test(0, 69) && !graph.test(69, 0) && !graph.test(5, 5));
+    assert(graph.row(10).count() == 59);
+
+    hmbl::Bitset<999> hmbl_b3 = hmbl_b2 | hmbl_b1;
+    const hmbl::Bitset<999> *and_ops[] = {&hmbl_b2, &hmbl_b3, &hmbl_b2};
+    assert(hmbl::Bitset<999>::and_any(and_ops));
+    assert(hmbl::Bitset<999>::and_count(and_ops) == 3);
+    assert(hmbl::Bitset<999>::and_first(and_ops) == 0);
+    const hmbl::Bitset<999> *and_ops_none[] = {&hmbl_b1, &hmbl_b3, &hmbl_b2};
+    assert(!hmbl::Bitset<999>::and_any(and_ops_none) && !hmbl::Bitset<999>::and_first(and_ops_none));
+
+    hmbl::BitsetHashSet<hmbl::Bitset<999>> bs_set;
+    assert(bs_set.insert(hmbl_b1) && !bs_set.insert(hmbl_b1) && bs_set.insert(hmbl_b2));
+    assert(bs_set.contains(hmbl_b2) && !bs_set.contains(hmbl_b2 << 1) && bs_set.size() == 2);
+    assert(bs_set.erase(hmbl_b1) && !bs_set.contains(hmbl_b1) && bs_set.size() == 1);
+
+    hmbl::BitsetHashMap<hmbl::Bitset<999>, int> bs_map;
+    for (size_t i = 0; i < 999; ++i)
+        bs_map[hmbl_b2 << i] += 1;
+    assert(bs_map.size() == 999 && *bs_map.find(hmbl_b2 << 3) == 1 && !bs_map.find(hmbl_b1));
+
     using DBitset = hmbl::SparseDynamicBitset<hmbl::posix::AlignedAllocator<uint64_t, 64>>;
     size_t bits1[] = {65, 111, 555, 1'000'000};
     size_t bits2[] = {10, 132, 792, 5555, 1'000'000};
@@ -75,6 +135,124 @@ int main()
     auto res = DBitset::and_any(dyn_bitsets);
     // auto res2 = DBitset::and_any(dyn_bitsets2);
 
+    using ArenaDBitset = hmbl::SparseDynamicBitset<hmbl::posix::ArenaAllocator<uint64_t, 64>>;
+    DBitset const *dyn_bitsets_pair[] = {&db1, &db2};
+    hmbl::posix::AlignedArena arena(1 << 10);
+    size_t arena_capacity{};
+    for (size_t query = 0; query < 3; ++query)
+    {
+        hmbl::posix::ArenaAllocator<uint64_t, 64> arena_alloc(arena);
+        ArenaDBitset adb1(bits1, 2'000'000, arena_alloc);
+        ArenaDBitset adb2(bits2, 2'000'000, arena_alloc);
+        ArenaDBitset const *arena_bitsets[] = {&adb1, &adb2};
+        assert(ArenaDBitset::and_any(arena_bitsets) == DBitset::and_any(dyn_bitsets_pair));
+        arena.reset();
+        assert(!query || arena.capacity() == arena_capacity); // merged into one reused block
+        arena_capacity = arena.capacity();
+    }
+
+    using HugeDBitset = hmbl::SparseDynamicBitset<hmbl::posix::HugePageAllocator<uint64_t, 64>>;
+    HugeDBitset hdb1(bits1, size_t(1) << 30);
+    HugeDBitset hdb2(bits2, size_t(1) << 30);
+    HugeDBitset const *huge_bitsets[] = {&hdb1, &hdb2};
+    assert(HugeDBitset::and_any(huge_bitsets) == DBitset::and_any(dyn_bitsets_pair));
+
+    using NumaDBitset = hmbl::SparseDynamicBitset<hmbl::posix::NumaAllocator<uint64_t, 64>>;
+    NumaDBitset ndb1(bits1, 2'000'000, hmbl::posix::NumaPlacement::interleaved());
+    hmbl::posix::NumaReplicated<NumaDBitset> ndb2(NumaDBitset(bits2, 2'000'000));
+    assert(ndb2.size() == hmbl::posix::numa::nodes().size());
+    NumaDBitset const *numa_bitsets[] = {&ndb1, &ndb2.local()};
+    assert(NumaDBitset::and_any(numa_bitsets) == DBitset::and_any(dyn_bitsets_pair));
+
+    DBitset db1_copy(db1);
+    DBitset const *copy_bitsets[] = {&db1_copy, &db2};
+    assert(DBitset::and_any(copy_bitsets) == DBitset::and_any(dyn_bitsets_pair));
+
+    struct DBitsetTag;
+    using StatsAlloc   = hmbl::posix::StatsAllocator<hmbl::posix::AlignedAllocator<uint64_t, 64>, DBitsetTag>;
+    using StatsDBitset = hmbl::SparseDynamicBitset<StatsAlloc>;
+    {
+        StatsDBitset sdb1(bits1, 2'000'000);
+        StatsDBitset sdb2(bits2, 2'000'000);
+        auto stats = StatsAlloc::stats().snapshot();
+        assert(stats.allocations == 6 && stats.deallocations == 0);
+        assert(stats.live_bytes == sdb1.memory_usage() + sdb2.memory_usage());
+        assert(stats.peak_bytes == stats.live_bytes);
+    }
+    assert(StatsAlloc::stats().snapshot().live_bytes == 0);
+
+    assert(db2.size() == 2'000'000 && db2.count() == 5 && db2.test(5555) && !db2.test(5556));
+    std::vector<size_t> db2_bits;
+    db2.for_each([&](size_t pos) { db2_bits.push_back(pos); return true; });
+    assert(db2_bits == std::vector<size_t>(std::begin(bits2), std::end(bits2)));
+    size_t bits_hi[] = {100, 1'000'000}; // high half of a 128 bit word
+    DBitset db_hi(bits_hi, 2'000'000);
+    DBitset const *hi_bitsets[] = {&db_hi, &db2};
+    assert(DBitset::and_any(hi_bitsets) == 1'000'000);
+
+    DBitset db_stream;
+    for (size_t pos : bits2)
+        db_stream.append(pos);
+    db_stream.append(3'000'000); // past the end of db2
+    assert(db_stream.size() == 3'000'001 && db_stream.count() == 6 && db_stream.version() == 6);
+    DBitset const *stream_bitsets[] = {&db1, &db_stream};
+    assert(DBitset::and_any(stream_bitsets) == 1'000'000 && !db1.cursor().test(3'000'000));
+
+    hmbl::SparseBitsetQuery<DBitset> query;
+    auto resolve = [&](std::string_view name) -> const DBitset *
+    {
+        return name == "db1" ? &db1 : name == "db2" ? &db2 : name == "db3" ? &db3 : nullptr;
+    };
+    auto q_and = query.parse("db1 & db2", resolve);
+    assert(q_and && query.first(*q_and) == 1'000'000 && query.count(*q_and) == 1);
+    auto q_not = query.parse("db2 & !db1", resolve);
+    assert(q_not && query.count(*q_not) == 4 && query.first(*q_not) == 10);
+    auto q_or = query.parse("(db3 | db1) & db2 | !(db1 | db3) & (db1 | db3)", resolve);
+    assert(q_or && query.materialize(*q_or) == std::vector<size_t>{1'000'000});
+    assert(query.stats().reused > 0); // db1 | db3 is evaluated once
+    assert(*query.parse("db3|db1", resolve) == query.or_of({query.term(db1), query.term(db3)}));
+    assert(!query.parse("db1 &", resolve) && !query.parse("db1 & db9", resolve) && !query.parse("(db1", resolve));
+
+    hmbl::SparseBitsetQuery<DBitset> stream_query; // terms of different sizes, one growing
+    auto q_stream     = stream_query.and_of({stream_query.term(db1), stream_query.term(db_stream)});
+    auto q_not_stream = stream_query.not_of(stream_query.term(db_stream));
+    assert(stream_query.count(q_stream) == 1 && stream_query.count(q_not_stream) == 3'000'001 - 6);
+    db_stream.append(3'000'005);
+    assert(stream_query.count(q_not_stream) == 3'000'006 - 7 && stream_query.universe() == 3'000'006);
+    {
+        DBitset db_far; // neither read after it's gone nor widening the universe of other roots
+        db_far.append(5'000'000);
+        assert(stream_query.count(stream_query.term(db_far)) == 1 && stream_query.universe() == 5'000'001);
+    }
+    assert(stream_query.count(q_not_stream) == 3'000'006 - 7 && stream_query.universe() == 3'000'006);
+
+    struct CacheTag;
+    using CacheAlloc = hmbl::posix::StatsAllocator<hmbl::posix::AlignedAllocator<uint64_t, 64>, CacheTag>;
+    {
+        hmbl::IntersectionCache<DBitset, CacheAlloc> cache(1 << 12, 1);
+        DBitset const *pair_swapped[] = {&db2, &db1};
+        assert(cache.and_any(dyn_bitsets_pair) == 1'000'000 && cache.and_any(pair_swapped) == 1'000'000);
+        auto swapped = cache.intersect(pair_swapped);
+        assert(swapped->size() == 1 && swapped->front() == 1'000'000);
+        auto held = cache.intersect(dyn_bitsets_pair);
+        auto stats = cache.stats();
+        assert(stats.hits == 2 && stats.misses == 2 && stats.entries == 1 && stats.hit_rate() == 0.5);
+        assert(CacheAlloc::stats().snapshot().live_bytes > 0);
+        DBitset db1_moved(std::move(db1_copy)); // the moved from bitset isn't its former contents
+        DBitset const *moved_bitsets[] = {&db1_copy, &db2};
+        assert(!cache.and_any(moved_bitsets) && cache.stats().misses == 3);
+        DBitset const *all_bitsets[] = {&db1, &db2, &db3, &db4, &db5, &db6, &db7, &db8, &db_hi};
+        assert(!cache.and_any(all_bitsets) && cache.stats().bypassed == 1);
+        for (auto *db : dyn_bitsets)
+        {
+            DBitset const *single[] = {db};
+            cache.intersect(single);
+        }
+        assert(cache.stats().evictions > 0 && cache.stats().bytes <= 1 << 12);
+        assert(held->size() == 1 && held->front() == 1'000'000); // outlives its entry
+    }
+    assert(CacheAlloc::stats().snapshot().live_bytes == 0);
+
     printf("res = %lu sizeof(__m512i) = %lu bitset<128> = %lu\n", res.value_or(0), sizeof(__m512i), sizeof(std::bitset<128>));
     // printf("res = %lu sizeof(__m512i) = %lu bitset<128> = %lu\n", res2.value_or(0), sizeof(__m512i), sizeof(std::bitset<128>));
 